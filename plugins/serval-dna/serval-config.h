@@ -0,0 +1,18 @@
+#ifndef __CO_SERVAL_CONFIG_H
+#define __CO_SERVAL_CONFIG_H
+
+#define HAVE_BCOPY 1
+#define HAVE_BZERO 1
+#define HAVE_BCMP 1
+#define HAVE_LSEEK64 1
+#define HAVE_ARPA_INET_H 1
+#define HAVE_POLL_H 1
+#define HAVE_SYS_SOCKET_H 1
+#define HAVE_NETINET_IN_H 1
+
+#define DEFAULT_SID "0000000000000000000000000000000000000000000000000000000000000000"
+#define DEFAULT_MDP_PATH "/etc/commotion/keys.d/mdp.keyring/serval.keyring"
+#define DEFAULT_SERVAL_PATH "/var/serval-node"
+#define PATH_MAX 4096
+
+#endif
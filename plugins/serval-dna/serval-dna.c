@@ -83,10 +83,8 @@ error:
 
 extern keyring_file *keyring;  // Serval global
 extern char *serval_path;
+static char _serval_path[PATH_MAX];
 
-co_socket_t co_socket_proto = {};
-
-static co_obj_t *sock_alarms = NULL;
 static co_obj_t *timer_alarms = NULL;
 bool serval_registered = false;
 bool daemon_started = false;
@@ -94,15 +92,6 @@ svl_crypto_ctx *serval_dna_ctx = NULL;
 
 // Private functions
 
-/** Compares co_socket fd to serval alarm fd */
-static co_obj_t *_alarm_fd_match_i(co_obj_t *alarms, co_obj_t *alarm, void *fd) {
-  if(!IS_ALARM(alarm)) return NULL;
-  const struct sched_ent *this_alarm = ((co_alarm_t*)alarm)->alarm;
-  const int *this_fd = fd;
-  if (this_alarm->poll.fd == *this_fd) return alarm;
-  return NULL;
-}
-
 static co_obj_t *_alarm_ptr_match_i(co_obj_t *alarms, co_obj_t *alarm, void *ptr) {
   if(!IS_ALARM(alarm)) return NULL;
   const struct sched_ent *this_alarm = ((co_alarm_t*)alarm)->alarm;
@@ -115,24 +104,15 @@ static co_obj_t *_alarm_ptr_match_i(co_obj_t *alarms, co_obj_t *alarm, void *ptr
 // Public functions
 
 /** Callback function for when Serval socket has data to read */
-int serval_socket_cb(co_obj_t *self, co_obj_t *context) {
+int serval_socket_cb(int fd, uint32_t revents, void *context) {
 //   DEBUG("SERVAL_SOCKET_CB");
-  co_socket_t *sock = (co_socket_t*)self;
-  co_obj_t *node = NULL;
-  struct sched_ent *alarm = NULL;
+  struct sched_ent *alarm = context;
   
-  // find alarm associated w/ sock, call alarm->function(alarm)
-  if ((node = co_list_parse(sock_alarms, _alarm_fd_match_i, &sock->fd->fd))) {
-    alarm = ((co_alarm_t*)node)->alarm;
-    alarm->poll.revents = sock->events;
-    
-    alarm->function(alarm); // Serval callback function associated with alarm/socket
-    alarm->poll.revents = 0;
-    
-    return 1;
-  }
+  alarm->poll.revents = revents;
+  alarm->function(alarm); // Serval callback function associated with alarm/socket
+  alarm->poll.revents = 0;
   
-  return 0;
+  return 1;
 }
 
 int serval_timer_cb(co_obj_t *self, co_obj_t **output, co_obj_t *context) {
@@ -203,6 +183,9 @@ int _schedule(struct __sourceloc __whence, struct sched_ent *alarm) {
   }
 
   CHECK_MEM((timer = co_timer_create(deadline, serval_timer_cb, alarm)));
+  co_timer_set_name(timer, "serval");
+  // anything up to Serval's deadline is on time, so let the loop batch it with other timers
+  ((co_timer_t*)timer)->slack = alarm->deadline - alarm->alarm;
   CHECK(co_loop_add_timer(timer,NULL),"Failed to add timer %ld.%06ld %p",deadline.tv_sec,deadline.tv_usec,alarm);
   co_obj_t *alarm_obj = co_alarm_create(alarm);
   CHECK_MEM(alarm_obj);
@@ -239,76 +222,26 @@ error:
 /** Overridden Serval function to register sockets with event loop */
 int _watch(struct __sourceloc __whence, struct sched_ent *alarm) {
 //   DEBUG("OVERRIDDEN WATCH FUNCTION!");
-  co_socket_t *sock = NULL;
-  
-  /** need to set:
-   * 	sock->fd
-   * 	sock->rfd
-   * 	sock->listen
-   * 	sock->uri
-   * 	sock->poll_cb
-   * 	sock->fd_registered
-   * 	sock->rfd_registered
-   */
-  
-  if ((alarm->_poll_index == 1) || co_list_parse(sock_alarms, _alarm_ptr_match_i, alarm)) {
-    WARN("Socket %d already registered: %d",alarm->poll.fd,alarm->_poll_index);
-  } else {
-    sock = (co_socket_t*)NEW(co_socket, co_socket);
-    CHECK_MEM(sock);
-    
-    sock->fd = (co_fd_t*)co_fd_create((co_obj_t*)sock,alarm->poll.fd);
-    CHECK_MEM(sock->fd);
-    hattach(sock->fd, sock);
-    sock->rfd_lst = co_list16_create();
-    CHECK_MEM(sock->rfd_lst);
-    hattach(sock->rfd_lst, sock);
-    sock->listen = true;
-    // NOTE: Aren't able to get the Serval socket uris, so instead use string representation of fd
-    sock->uri = h_calloc(1,6);
-    CHECK_MEM(sock->uri);
-    hattach(sock->uri,sock);
-    sprintf(sock->uri,"%d",sock->fd->fd);
-    sock->fd_registered = false;
-    sock->local = NULL;
-    sock->remote = NULL;
-  
-    sock->poll_cb = serval_socket_cb;
-  
-    // register sock
-    CHECK(co_loop_add_socket((co_obj_t*)sock, (co_obj_t*)sock->fd) == 1,"Failed to add socket %d",sock->fd->fd);
-    DEBUG("Successfully added socket %d",sock->fd->fd);
-  
-    sock->fd_registered = true;
-    // NOTE: it would be better to get the actual poll index from the event loop instead of this:
-    alarm->_poll_index = 1;
-    alarm->poll.revents = 0;
-    
-    co_obj_t *alarm_obj = co_alarm_create(alarm);
-    CHECK_MEM(alarm_obj);
-    CHECK(co_list_append(sock_alarms, alarm_obj),"Failed to add to sock_alarms");
-    DEBUG("Successfully added to sock_alarms %p",alarm);
-  }
+  
+  /* Serval's poll events share their values with epoll's, and watching an
+   * already watched fd just updates its events */
+  CHECK(co_loop_watch_fd(alarm->poll.fd, alarm->poll.events, serval_socket_cb, alarm),"Failed to add socket %d",alarm->poll.fd);
+  DEBUG("Successfully watching socket %d",alarm->poll.fd);
+  
+  // NOTE: it would be better to get the actual poll index from the event loop instead of this:
+  alarm->_poll_index = 1;
+  alarm->poll.revents = 0;
   
   return 0;
 error:
-  if (sock) co_socket_destroy((co_obj_t*)sock);
   return -1;
 }
 
 int _unwatch(struct __sourceloc __whence, struct sched_ent *alarm) {
 //   DEBUG("OVERRIDDEN UNWATCH FUNCTION!");
-  co_obj_t *node = NULL;
-  char fd_str[6] = {0};
-  
-  CHECK(alarm->_poll_index == 1 && (node = co_list_parse(sock_alarms, _alarm_ptr_match_i, alarm)),"Attempting to unwatch socket that is not registered");
-  co_list_delete(sock_alarms,node);
   
-  // Get the socket associated with the alarm (alarm's fd is equivalent to the socket's uri)
-  sprintf(fd_str,"%d",alarm->poll.fd);
-  CHECK((node = co_loop_get_socket(fd_str,NULL)),"Could not find socket to remove");
-  CHECK(co_loop_remove_socket(node,NULL),"Failed to remove socket");
-  CHECK(co_socket_destroy(node),"Failed to destroy socket");
+  CHECK(alarm->_poll_index == 1,"Attempting to unwatch socket that is not registered");
+  CHECK(co_loop_unwatch_fd(alarm->poll.fd),"Failed to remove socket %d",alarm->poll.fd);
   
   alarm->_poll_index = -1;
   
@@ -408,7 +341,13 @@ int co_plugin_register(co_obj_t *self, co_obj_t **output, co_obj_t *params) {
 }
 
 static int serval_load_config(void) {
-  CHECK(co_profile_get_str(co_profile_global(),&serval_path,"serval_path",sizeof("serval_path")) < PATH_MAX - 16,"serval_path config parameter too long");
+  char *path = NULL;
+  ssize_t len = co_profile_get_str(co_profile_global(),&path,"serval_path",sizeof("serval_path"));
+  CHECK(len > 0,"serval_path config parameter not set");
+  CHECK(len < PATH_MAX - 16,"serval_path config parameter too long");
+  /* Copied, since a reload of the global profile frees the value */
+  snprintf(_serval_path, sizeof(_serval_path), "%s", path);
+  serval_path = _serval_path;
   if (serval_path[strlen(serval_path) - 1] == '/')
     serval_path[strlen(serval_path) - 1] = '\0'; // remove trailing slash
   CHECK(setenv("SERVALINSTANCE_PATH",serval_path,1) == 0,"Failed to set SERVALINSTANCE_PATH env variable");
@@ -459,9 +398,7 @@ int co_plugin_init(co_obj_t *self, co_obj_t **output, co_obj_t *params) {
   
   overlay_queue_init();
   
-  // Initialize our list of Serval alarms/sockets
-  sock_alarms = co_list16_create();
-  CHECK_MEM(sock_alarms);
+  // Initialize our list of Serval alarms
   timer_alarms = co_list16_create();
   CHECK_MEM(timer_alarms);
   
@@ -533,7 +470,6 @@ int co_plugin_shutdown(co_obj_t *self, co_obj_t **output, co_obj_t *params) {
   
   daemon_started = false;
   
-  co_obj_free(sock_alarms);
   co_obj_free(timer_alarms);
   
   return 1;
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "debug.h"
 #include "obj.h"
 #include "list.h"
@@ -41,6 +42,22 @@
 
 static co_obj_t *_cmds = NULL;
 
+/* Commands share the profile and interface state, so only one runs at a
+ * time, whether on the loop thread or a worker. Recursive so handlers and
+ * hooks can call back into co_cmd_exec. */
+static pthread_mutex_t _cmd_lock;
+static pthread_once_t _cmd_lock_once = PTHREAD_ONCE_INIT;
+
+static void
+_co_cmd_lock_init(void)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&_cmd_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
 void
 co_cmds_shutdown(void)
 {
@@ -51,6 +68,7 @@ co_cmds_shutdown(void)
 int
 co_cmds_init(const size_t index_size)
 {
+  pthread_once(&_cmd_lock_once, _co_cmd_lock_init);
   if(_cmds == NULL)
   {
     if(index_size == 16)
@@ -73,11 +91,12 @@ error:
 }
 
 static co_obj_t *
-_co_cmd_create(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler) 
+_co_cmd_create(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler, const uint8_t flags) 
 {
   DEBUG("Creating command %s", name);
   co_cmd_t *cmd = h_calloc(1, sizeof(co_cmd_t));
   cmd->exec = handler;
+  cmd->flags = flags;
   CHECK_MEM(cmd->name = co_str8_create(name, nlen, 0));
   hattach(cmd->name, cmd);
   CHECK_MEM(cmd->usage = co_str16_create(usage, ulen, 0));
@@ -98,27 +117,62 @@ error:
 int
 co_cmd_register(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler) 
 {
-  CHECK(co_tree_insert(_cmds, name, strlen(name), _co_cmd_create(name, nlen, usage, ulen, desc, dlen, handler)), "Failed to register command.");
+  return co_cmd_register_flags(name, nlen, usage, ulen, desc, dlen, handler, 0);
+}
+
+int
+co_cmd_register_flags(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler, const uint8_t flags) 
+{
+  CHECK(co_tree_insert(_cmds, name, strlen(name), _co_cmd_create(name, nlen, usage, ulen, desc, dlen, handler, flags)), "Failed to register command.");
   return 1;
 error:
   return 0;
 }
 
-
-int
-co_cmd_exec(co_obj_t *key, co_obj_t **output, co_obj_t *param) 
+co_cmd_t *
+co_cmd_find(co_obj_t *key) 
 {
   char *kstr = NULL;
   ssize_t klen = co_obj_data(&kstr, key);
   CHECK(klen > 0, "Failed to extract command key");
-  co_cmd_t *cmd = (co_cmd_t *)co_tree_find(_cmds, kstr, klen - 1);
-  
+  return (co_cmd_t *)co_tree_find(_cmds, kstr, klen - 1);
+error:
+  return NULL;
+}
+
+int
+co_cmd_run(co_cmd_t *cmd, co_obj_t **output, co_obj_t *param) 
+{
   CHECK((cmd != NULL), "No such command!");
-  return cmd->exec((co_obj_t *)cmd, output, param);
+  pthread_mutex_lock(&_cmd_lock);
+  int ret = cmd->exec((co_obj_t *)cmd, output, param);
+  pthread_mutex_unlock(&_cmd_lock);
+  return ret;
 error:
   return 0;
 }
 
+int
+co_cmd_run_nowait(co_cmd_t *cmd, co_obj_t **output, co_obj_t *param) 
+{
+  if(pthread_mutex_trylock(&_cmd_lock) != 0) return -1;
+  int ret = co_cmd_run(cmd, output, param);
+  pthread_mutex_unlock(&_cmd_lock);
+  return ret;
+}
+
+int
+co_cmd_exec(co_obj_t *key, co_obj_t **output, co_obj_t *param) 
+{
+  return co_cmd_run(co_cmd_find(key), output, param);
+}
+
+int
+co_cmd_exec_nowait(co_obj_t *key, co_obj_t **output, co_obj_t *param) 
+{
+  return co_cmd_run_nowait(co_cmd_find(key), output, param);
+}
+
 co_obj_t *
 co_cmd_usage(co_obj_t *key) 
 {
@@ -42,6 +42,11 @@
 
 #define CMD_REGISTER(N, U, D) co_cmd_register(#N, sizeof(#N), U, sizeof(U), D, sizeof(D), cmd_##N )
 
+#define CMD_REGISTER_FLAGS(N, U, D, F) co_cmd_register_flags(#N, sizeof(#N), U, sizeof(U), D, sizeof(D), cmd_##N, F)
+
+#define CMD_BLOCKING (1 << 0) /**< handler may block; run it on a worker thread */
+#define CMD_PUBLIC (1 << 1) /**< reveals no profile values (keys among them); any client may run it, not just privileged peers */
+
 #define CMD_OUTPUT(K, V) if(*output == NULL) *output = co_tree16_create(); co_tree_insert(*output, K, sizeof(K), V)
 
 #define HOOK(N) static int hook_##N##(co_obj_t *self, co_obj_t **output, co_obj_t *params)
@@ -67,10 +72,40 @@ struct co_cmd_t {
   co_obj_t *usage; /**< usage syntax */
   co_obj_t *desc; /**< description */
   co_obj_t *hooks;
+  uint8_t flags; /**< CMD_* flags given at registration */
 } __attribute__((packed));
 
 int co_cmd_register(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler); 
 
+/**
+ * @brief registers a command with flags (e.g. CMD_BLOCKING)
+ * @param flags bitwise OR of CMD_* flags
+ */
+int co_cmd_register_flags(const char *name, const size_t nlen, const char *usage, const size_t ulen, const char *desc, const size_t dlen, co_cb_t handler, const uint8_t flags);
+
+/**
+ * @brief looks up a command, e.g. to check its flags before running it
+ * @param key the name of the command
+ * @return the command, or NULL if there is none by that name
+ */
+co_cmd_t *co_cmd_find(co_obj_t *key);
+
+/**
+ * @brief runs a command found with co_cmd_find
+ * @param cmd the command
+ * @param output return object of command
+ */
+int co_cmd_run(co_cmd_t *cmd, co_obj_t **output, co_obj_t *param);
+
+/**
+ * @brief like co_cmd_run, but doesn't wait if a command is already
+ * running on another thread
+ * @param cmd the command
+ * @param output return object of command
+ * @return -1 if the command lock is busy
+ */
+int co_cmd_run_nowait(co_cmd_t *cmd, co_obj_t **output, co_obj_t *param);
+
 /**
  * @brief executes a command by running the function linked to in the command struct
  * @param key the name of the command
@@ -78,6 +113,15 @@ int co_cmd_register(const char *name, const size_t nlen, const char *usage, cons
  */
 int co_cmd_exec(co_obj_t *key, co_obj_t **output, co_obj_t *param);
 
+/**
+ * @brief like co_cmd_exec, but doesn't wait if a command is already
+ * running on another thread
+ * @param key the name of the command
+ * @param output return object of command
+ * @return -1 if the command lock is busy
+ */
+int co_cmd_exec_nowait(co_obj_t *key, co_obj_t **output, co_obj_t *param);
+
 /**
  * @brief returns command usage format
  * @param key command name
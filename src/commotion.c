@@ -30,6 +30,9 @@
  */
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include "debug.h"
 #include "obj.h"
@@ -42,11 +45,11 @@
 
 #define REQUEST_MAX 65536
 #define RESPONSE_MAX 65536
+#define CONNECTION_POOL_MAX 8 /**< idle connections kept open for reuse */
 
 static co_obj_t *_pool = NULL;
 static co_obj_t *_sockets = NULL;
-
-extern co_socket_t unix_socket_proto;
+static co_obj_t *_idle = NULL;
 
 int
 co_init(void)
@@ -55,6 +58,8 @@ co_init(void)
   _pool = h_calloc(1, sizeof(_pool));
   _sockets = co_list16_create();
   hattach(_sockets, _pool);
+  _idle = co_list16_create();
+  hattach(_idle, _pool);
   DEBUG("Commotion API initialized.");
   return 1;
 error:
@@ -74,24 +79,82 @@ co_shutdown(void)
   CHECK_MEM(_sockets);
   CHECK(IS_LIST(_sockets), "API not properly initialized.");
   co_list_parse(_sockets, _co_shutdown_sockets_i, NULL);
+  co_list_parse(_idle, _co_shutdown_sockets_i, NULL);
   co_obj_free(_pool);
   return 1;
 error:
   return 0;
 }
 
+static co_obj_t *
+_co_match_idle_i(co_obj_t *data, co_obj_t *current, void *context)
+{
+  const char *uri = context;
+  const char *this_uri = ((co_socket_t*)current)->uri;
+  if(strcmp(this_uri, uri) == 0) return current;
+  /* A bare path means unix:// */
+  if(strstr(uri, "://") == NULL && strncmp(this_uri, "unix://", sizeof("unix://") - 1) == 0 &&
+     strcmp(this_uri + sizeof("unix://") - 1, uri) == 0) return current;
+  return NULL;
+}
+
+/**
+ * @brief checks an idle connection before reuse: anything readable on it
+ * means the daemon hung up (or sent something nobody asked for)
+ */
+static bool
+_co_connection_alive(co_socket_t *sock)
+{
+  struct pollfd pfd = { .fd = sock->fd->fd, .events = POLLIN };
+  if(sock->fd->fd < 0) return false;
+  return poll(&pfd, 1, 0) == 0;
+}
+
+/**
+ * @brief closes a dead connection and dials its URI again
+ */
+static int
+_co_reconnect(co_socket_t *sock)
+{
+  char *uri = h_strdup(sock->uri);
+  CHECK_MEM(uri);
+  if(sock->fd->fd >= 0) close(sock->fd->fd);
+  sock->fd->fd = -1;
+  sock->fd->requests = 0;
+  CHECK(sock->connect((co_obj_t*)sock, uri), "Failed to reconnect to commotiond at %s.", uri);
+  h_free(uri);
+  return 1;
+error:
+  if(uri) h_free(uri);
+  return 0;
+}
+
 co_obj_t *
 co_connect(const char *uri, const size_t ulen)
 {
+  co_obj_t *socket = NULL;
   CHECK_MEM(_sockets);
   CHECK(uri != NULL && ulen > 0, "Invalid URI.");
-  co_obj_t *socket = NEW(co_socket, unix_socket);
+  /* Reuse a warm connection to the same daemon if one is idle */
+  while((socket = co_list_parse(_idle, _co_match_idle_i, (void*)uri)))
+  {
+    co_list_delete(_idle, socket);
+    if(_co_connection_alive((co_socket_t*)socket))
+    {
+      DEBUG("Reusing pooled connection to %s.", uri);
+      co_list_append(_sockets, socket);
+      return socket;
+    }
+    DEBUG("Dropping dead pooled connection to %s.", uri);
+    ((co_socket_t*)socket)->destroy(socket);
+  }
+  CHECK_MEM((socket = co_socket_create_uri(uri)));
   hattach(socket, _pool);
   CHECK((((co_socket_t*)socket)->connect(socket, uri)), "Failed to connect to commotiond at %s\n", uri);
   co_list_append(_sockets, socket);
   return socket;
 error:
-  co_obj_free(socket);
+  if(socket) co_obj_free(socket);
   return NULL;
 }
 
@@ -103,7 +166,11 @@ co_disconnect(co_obj_t *connection)
   CHECK(IS_SOCK(connection), "Specified object is not a Commotion socket.");
   
   co_list_delete(_sockets, connection);
-  ((co_socket_t*)connection)->destroy(connection);
+  /* Keep it open for the next co_connect to the same URI */
+  if(((co_socket_t*)connection)->fd->fd >= 0 && co_list_length(_idle) < CONNECTION_POOL_MAX)
+    co_list_append(_idle, connection);
+  else
+    ((co_socket_t*)connection)->destroy(connection);
   return 1;
 error:
   return 0;
@@ -182,17 +249,53 @@ error:
   return 0;
 }
 
+/**
+ * @brief reads until the buffer starts with one whole response
+ * @param sock connection to read from
+ * @param buf buffer, starting as the caller's stack buffer; moved to the
+ * heap if a response (e.g. a dump) doesn't fit, which the caller frees
+ * @param cap size of buf
+ * @param have bytes already in buf
+ * @param stack the caller's stack buffer
+ * @return length of the response, 0 on end-of-file before any data, -1 on error
+ */
+static ssize_t
+_co_receive_frame(co_socket_t *sock, char **buf, size_t *cap, size_t *have, char *stack)
+{
+  ssize_t flen = 0, s = 0;
+  char *grown = NULL;
+  while((flen = co_message_length(*buf, *have)) == 0)
+  {
+    if(*have == *cap)
+    {
+      CHECK_MEM(grown = (*buf == stack) ? h_malloc(*cap * 2) : h_realloc(*buf, *cap * 2));
+      if(*buf == stack) memmove(grown, stack, *have);
+      *buf = grown;
+      *cap *= 2;
+    }
+    s = sock->receive((co_obj_t*)sock, (co_obj_t*)sock->fd, *buf + *have, *cap - *have);
+    if(s == 0 && *have == 0) return 0;
+    CHECK(s > 0, "Failed to receive data.");
+    *have += s;
+  }
+  CHECK(flen > 0, "Failed to parse response.");
+  return flen;
+error:
+  return -1;
+}
+
 int
 co_call(co_obj_t *connection, co_obj_t **response, const char *method, const size_t mlen, co_obj_t *request)
 {
-  CHECK(method != NULL && mlen > 0 && mlen < UINT8_MAX, "Invalid method name.");
-  CHECK(connection != NULL && IS_SOCK(connection), "Invalid connection.");
-  co_obj_t *params = NULL, *rlist = NULL, *rtree = NULL;
+  co_obj_t *params = NULL, *rlist = NULL, *rtree = NULL, *m = NULL;
   int retval = 0;
-  size_t reqlen = 0;
+  size_t reqlen = 0, rcap = RESPONSE_MAX, have = 0;
   ssize_t resplen = 0;
   char req[REQUEST_MAX];
   char resp[RESPONSE_MAX];
+  char *rbuf = resp;
+  CHECK(method != NULL && mlen > 0 && mlen < UINT8_MAX, "Invalid method name.");
+  CHECK(connection != NULL && IS_SOCK(connection), "Invalid connection.");
   if(request != NULL)
   {
     CHECK(IS_LIST(request), "Not a valid request.");
@@ -202,12 +305,27 @@ co_call(co_obj_t *connection, co_obj_t **response, const char *method, const siz
   {
     params = co_list16_create();
   }
-  co_obj_t *m = co_str8_create(method, mlen, 0);
+  m = co_str8_create(method, mlen, 0);
+  co_socket_t *sock = (co_socket_t*)connection;
   reqlen = co_request_alloc(req, sizeof(req), m, params);
-  CHECK(((co_socket_t*)connection)->send((co_obj_t*)((co_socket_t*)connection)->fd, req, reqlen) != -1, "Send error!");
-  if((resplen = ((co_socket_t*)connection)->receive(connection, (co_obj_t*)((co_socket_t*)connection)->fd, resp, sizeof(resp))) > 0) 
+  /* A connection the daemon closed since its last use fails the send
+   * (EPIPE) or reads end-of-file, which a reset (ECONNRESET) also reads as:
+   * redial once and resend. End-of-file on a connection that has never
+   * answered isn't a stale one, and the command may already have run, so
+   * that isn't retried; nor are timeouts. */
+  bool fresh = (sock->fd->requests == 0);
+  if(sock->send((co_obj_t*)sock->fd, req, reqlen) == -1 ||
+     ((resplen = _co_receive_frame(sock, &rbuf, &rcap, &have, resp)) == 0 && !fresh))
+  {
+    WARN("Connection to %s lost, reconnecting.", sock->uri);
+    CHECK(_co_reconnect(sock), "Send error!");
+    CHECK(sock->send((co_obj_t*)sock->fd, req, reqlen) != -1, "Send error!");
+    resplen = _co_receive_frame(sock, &rbuf, &rcap, &have, resp);
+  }
+  if(resplen > 0) 
   {
-    CHECK(co_list_import(&rlist, resp, resplen) > 0 && co_list_length(rlist) == 4, "Failed to parse response.");
+    CHECK(co_list_import(&rlist, rbuf, resplen) > 0 && co_list_length(rlist) == 4, "Failed to parse response.");
+    sock->fd->requests++;
     rtree = co_list_element(rlist, 3);
     if(!IS_NIL(rtree))
     {
@@ -230,11 +348,93 @@ co_call(co_obj_t *connection, co_obj_t **response, const char *method, const siz
 error:
   if (rlist)
     co_obj_free(rlist);
-  co_obj_free(m);
+  if (rbuf != resp) h_free(rbuf);
+  if (m) co_obj_free(m);
   if(params != request) co_obj_free(params);
   return retval;
 }
 
+/**
+ * @brief sets a call's response and status from an imported response
+ */
+static int
+_co_call_result(co_call_t *call, co_obj_t *rlist)
+{
+  co_obj_t *rtree = co_list_element(rlist, 3);
+  call->status = !IS_NIL(rtree);
+  if(!call->status) rtree = co_list_element(rlist, 2);
+  CHECK(rtree != NULL && IS_TREE(rtree), "Invalid response.");
+  co_list_delete(rlist, rtree);
+  call->response = rtree;
+  hattach(call->response, _pool);
+  return 1;
+error:
+  return 0;
+}
+
+int
+co_call_batch(co_obj_t *connection, co_call_t *calls, const size_t n)
+{
+  co_socket_t *sock = (co_socket_t*)connection;
+  co_obj_t *params = NULL, *m = NULL, *rlist = NULL;
+  uint32_t first = 0, *id = NULL;
+  size_t reqlen = 0, have = 0, rcap = RESPONSE_MAX, done = 0, i = 0;
+  ssize_t s = 0, flen = 0;
+  char req[REQUEST_MAX];
+  char resp[RESPONSE_MAX];
+  char *rbuf = resp;
+  CHECK(connection != NULL && IS_SOCK(connection), "Invalid connection.");
+  CHECK(calls != NULL && n > 0, "No calls to make.");
+
+  /* Pack every request into one buffer; IDs come out consecutive */
+  for(i = 0; i < n; i++)
+  {
+    CHECK(calls[i].method != NULL && calls[i].mlen > 0 && calls[i].mlen < UINT8_MAX, "Invalid method name.");
+    CHECK(calls[i].request == NULL || IS_LIST(calls[i].request), "Not a valid request.");
+    calls[i].response = NULL;
+    calls[i].status = 0;
+    params = calls[i].request ? calls[i].request : co_list16_create();
+    m = co_str8_create(calls[i].method, calls[i].mlen, 0);
+    s = co_request_alloc(req + reqlen, sizeof(req) - reqlen, m, params);
+    co_obj_free(m);
+    if(params != calls[i].request) co_obj_free(params);
+    CHECK(s > 0, "Batch too large for one request buffer.");
+    if(i == 0) first = co_request_id(req);
+    reqlen += s;
+  }
+
+  /* Only a failed send is retried: once it is out, commands may have run */
+  if(sock->send((co_obj_t*)sock->fd, req, reqlen) == -1)
+  {
+    WARN("Connection to %s lost, reconnecting.", sock->uri);
+    CHECK(_co_reconnect(sock), "Send error!");
+    CHECK(sock->send((co_obj_t*)sock->fd, req, reqlen) != -1, "Send error!");
+  }
+
+  /* Responses may arrive several to a read, or split across reads */
+  for(done = 0; done < n; done++)
+  {
+    CHECK((flen = _co_receive_frame(sock, &rbuf, &rcap, &have, resp)) > 0, "Failed to receive data.");
+    CHECK(co_list_import(&rlist, rbuf, flen) == flen && co_list_length(rlist) == 4, "Failed to parse response.");
+    memmove(rbuf, rbuf + flen, have - flen);
+    have -= flen;
+    CHECK(co_obj_data((char **)&id, co_list_element(rlist, 1)) == sizeof(uint32_t), "Invalid response ID.");
+    i = *id - first;
+    CHECK(i < n && calls[i].response == NULL, "Unexpected response ID %u.", *id);
+    CHECK(_co_call_result(&calls[i], rlist), "Invalid response.");
+    sock->fd->requests++;
+    co_obj_free(rlist);
+    rlist = NULL;
+  }
+  if (rbuf != resp) h_free(rbuf);
+  return 1;
+
+error:
+  if (rlist) co_obj_free(rlist);
+  if (rbuf != resp) h_free(rbuf);
+  return 0;
+}
+
 co_obj_t *
 co_response_get(co_obj_t *response, const char *key, const size_t klen)
 {
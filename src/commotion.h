@@ -49,14 +49,17 @@ int co_init(void);
 int co_shutdown(void);
 
 /**
- * @brief creates a connection to Commotion daemon at the given URI
+ * @brief creates a connection to Commotion daemon at the given URI, reusing
+ * an idle pooled connection to the same URI if it is still healthy
  * @param uri URI string
  * @param ulen length of URI string
  */
 co_obj_t *co_connect(const char *uri, const size_t ulen);
 
 /**
- * @brief closes connection to Commotion daemon
+ * @brief releases connection to Commotion daemon; it is kept open in the
+ * pool for the next co_connect, up to a few idle connections, and closed
+ * for good by co_shutdown
  * @param connection context object for active connection
  */
 int co_disconnect(co_obj_t *connection);
@@ -113,6 +116,27 @@ int co_request_append_uint(co_obj_t *request, const unsigned int i);
  */
 int co_call(co_obj_t *connection, co_obj_t **response, const char *method, const size_t mlen, co_obj_t *request);
 
+/**
+ * @brief one call in a co_call_batch
+ */
+typedef struct co_call_t {
+  const char *method; /**< method name */
+  size_t mlen; /**< length of method name */
+  co_obj_t *request; /**< request object to send, or NULL */
+  co_obj_t *response; /**< set by co_call_batch */
+  int status; /**< set by co_call_batch: what co_call would have returned */
+} co_call_t;
+
+/**
+ * @brief sends several procedure calls to daemon in one write, then
+ * collects their responses (in whatever order they come back)
+ * @param connection context object for connection
+ * @param calls array of calls; response and status are filled in
+ * @param n number of calls
+ * @return 1 if every call got a response, 0 otherwise
+ */
+int co_call_batch(co_obj_t *connection, co_call_t *calls, const size_t n);
+
 /**
  * @brief retrieve object from response
  * @param response pointer to response object
@@ -39,6 +39,9 @@
 #include <sys/stat.h>
 #include <arpa/inet.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
 #include "config.h"
 #include "debug.h"
 #include "cmd.h"
@@ -54,11 +57,13 @@
 #include "obj.h"
 #include "list.h"
 #include "tree.h"
+#include "worker.h"
 
 #define REQUEST_MAX 4096
 #define RESPONSE_MAX 4096
+#define RESPONSE_LIMIT (16 * 1024 * 1024) /**< largest reply dispatcher_reply will encode */
+#define ACCEPT_BACKOFF 100 /**< ms before accepting again after running out of descriptors */
 
-extern co_socket_t unix_socket_proto;
 static int pid_filehandle;
 
 /* Global daemon variables. */
@@ -66,27 +71,32 @@ static char *_config = COMMOTION_CONFIGFILE;
 static char *_pid = NULL;
 static char *_state = NULL;
 static char *_bind = NULL;
+static unsigned long _max_connections = MAX_CONNECTIONS;
+static unsigned long _idle_timeout = SOCKET_IDLE_TIMEOUT;
 static char *_plugins = NULL;
 static char *_profiles = NULL;
+static co_socket_t *_socket = NULL;
+static co_obj_t *_accept_timer = NULL;
+static nodeid_t _derived_id; /* node id the profiles' derived values were generated with */
 
 SCHEMA(default)
 {
   SCHEMA_ADD("ssid", "commotionwireless.net"); 
-  SCHEMA_ADD("bssid", "02:CA:FF:EE:BA:BE"); 
-  SCHEMA_ADD("bssidgen", "true"); 
-  SCHEMA_ADD("channel", "5"); 
-  SCHEMA_ADD("mode", "adhoc"); 
-  SCHEMA_ADD("type", "mesh"); 
+  SCHEMA_ADD_TYPED("bssid", "02:CA:FF:EE:BA:BE", PROFILE_MAC); 
+  SCHEMA_ADD_TYPED("bssidgen", "true", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("channel", "5", PROFILE_UINT); 
+  SCHEMA_ADD_ENUM("mode", "adhoc", "adhoc|ap|sta|mesh"); 
+  SCHEMA_ADD_ENUM("type", "mesh", "mesh|ap|plug|client"); 
   SCHEMA_ADD("dns", "208.67.222.222"); 
   SCHEMA_ADD("domain", "mesh.local"); 
-  SCHEMA_ADD("ipgen", "true"); 
-  SCHEMA_ADD("ip", "100.64.0.0"); 
-  SCHEMA_ADD("netmask", "255.192.0.0"); 
-  SCHEMA_ADD("ipgenmask", "255.192.0.0"); 
+  SCHEMA_ADD_TYPED("ipgen", "true", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("ip", "100.64.0.0", PROFILE_IPV4); 
+  SCHEMA_ADD_TYPED("netmask", "255.192.0.0", PROFILE_IPV4); 
+  SCHEMA_ADD_TYPED("ipgenmask", "255.192.0.0", PROFILE_IPV4); 
   SCHEMA_ADD("encryption", "psk2"); 
   SCHEMA_ADD("key", "c0MM0t10n!r0cks"); 
-  SCHEMA_ADD("serval", "false"); 
-  SCHEMA_ADD("announce", "true");
+  SCHEMA_ADD_TYPED("serval", "false", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("announce", "true", PROFILE_BOOL);
   SCHEMA_ADD("routing", "olsr");
   return 1;
 }
@@ -99,6 +109,8 @@ SCHEMA(global)
   SCHEMA_ADD("plugins", COMMOTION_PLUGINDIR); 
   SCHEMA_ADD("profiles", COMMOTION_PROFILEDIR); 
   SCHEMA_ADD("id", "0"); 
+  SCHEMA_ADD_TYPED("max_connections", "32", PROFILE_UINT); 
+  SCHEMA_ADD_TYPED("idle_timeout", "300", PROFILE_UINT); 
   return 1;
 }
 
@@ -136,6 +148,23 @@ CMD(help)
   return co_cmd_process(_cmd_help_i, (void *)*output);
 }
 
+CMD(loopstats)
+{
+  CHECK((*output = co_loop_stats()) != NULL, "Failed to collect loop statistics.");
+  return 1;
+error:
+  return 0;
+}
+
+CMD(connections)
+{
+  CHECK(_socket != NULL, "No management socket.");
+  CHECK((*output = co_socket_connections((co_obj_t*)_socket)) != NULL, "Failed to collect connection statistics.");
+  return 1;
+error:
+  return 0;
+}
+
 static co_obj_t *
 _cmd_profiles_i(co_obj_t *data, co_obj_t *current, void *context) 
 {
@@ -177,22 +206,25 @@ CMD(up)
   co_obj_t *prof = co_profile_find(co_list_element(params, 1));
   CHECK(prof != NULL, "Failed to load profile.");
 #ifndef _OPENWRT
-  char *ipgen, *ip, *ipgenmask, *ssid, *bssid, *mode, *dns, *domain, *netmask;
+  char *ssid, *mode, *dns, *domain;
+  char netmask[INET_ADDRSTRLEN], bssid[BSSID_STR_SIZE];
+  struct in_addr ip, ipgenmask;
+  int ipgen;
   unsigned int chan;
-  CHECK(co_profile_get_str(prof, &ip, "ip", sizeof("ip")) > 0, "Failed to get 'ip' option.");
-  CHECK(co_profile_get_str(prof, &netmask, "netmask", sizeof("netmask")) > 0, "Failed to get 'netmask' option.");
-  CHECK(co_profile_get_str(prof, &ipgen, "ipgen", sizeof("ipgen")) > 0, "Failed to get 'ipgen' option.");
-  CHECK(co_profile_get_str(prof, &ipgenmask, "ipgenmask", sizeof("ipgenmask")) > 0, "Failed to get 'ipgenmask' option.");
+  CHECK(co_profile_get_ipv4(prof, "ip", sizeof("ip"), &ip), "Failed to get 'ip' option.");
+  CHECK(co_profile_get_text(prof, "netmask", sizeof("netmask"), netmask, sizeof(netmask)) > 0, "Failed to get 'netmask' option.");
+  CHECK((ipgen = co_profile_get_bool(prof, "ipgen", sizeof("ipgen"))) >= 0, "Failed to get 'ipgen' option.");
+  CHECK(co_profile_get_ipv4(prof, "ipgenmask", sizeof("ipgenmask"), &ipgenmask), "Failed to get 'ipgenmask' option.");
   CHECK(co_profile_get_str(prof, &ssid, "ssid", sizeof("ssid")) > 0, "Failed to get 'ssid' option.");
-  CHECK(co_profile_get_str(prof, &bssid, "bssid", sizeof("bssid")) > 0, "Failed to get 'bssid' option.");
+  CHECK(co_profile_get_text(prof, "bssid", sizeof("bssid"), bssid, sizeof(bssid)) > 0, "Failed to get 'bssid' option.");
   CHECK(co_profile_get_str(prof, &mode, "mode", sizeof("mode")) > 0, "Failed to get 'mode' option.");
   CHECK(co_profile_get_str(prof, &dns, "dns", sizeof("dns")) > 0, "Failed to get 'dns' option.");
   CHECK(co_profile_get_str(prof, &domain, "domain", sizeof("domain")) > 0, "Failed to get 'domain' option.");
   chan = co_profile_get_uint(prof, "channel", sizeof("channel"));
-  CHECK(chan >= 0, "Failed to get 'channel' option.");
+  CHECK(chan != (unsigned int)-1, "Failed to get 'channel' option.");
   /* Load interface configurations from profile */
-  if(!strcmp("true", ipgen )) {
-    co_generate_ip(ip, ipgenmask, co_id_get(), address, 0);
+  if(ipgen) {
+    co_generate_ip_addr(ip, ipgenmask, co_id_get(), address, 0);
   }
   DEBUG("Address: %s", address);
   
@@ -265,7 +297,8 @@ CMD(state)
   memset(address, '\0', sizeof(address));
   char *ifname = NULL;
   char *propname = NULL;
-  char *ssid = NULL, *chan = NULL, *ipgen = NULL, *ipgenmask = NULL, *type = NULL, *ip = NULL, *bssidgen = NULL;
+  char *ssid = NULL, *type = NULL;
+  struct in_addr ip, ipgenmask;
   co_obj_t *object = NULL;
   int t = 0;
   co_obj_t *iface = co_list_element(params, 0);
@@ -278,77 +311,62 @@ CMD(state)
   char *profile_name = NULL; 
   CHECK((profile_name = co_iface_profile(ifname)), "Interface state is inactive."); 
   DEBUG("profile_name: %s", profile_name);
-  co_obj_t *p = co_str8_create(profile_name, strlen(profile_name)+1, 0);
   co_obj_t *prof = NULL;
-  CHECK((prof = co_profile_find(p)), "Could not load profile."); 
-  if(!strcmp(propname, "ip"))
+  CHECK((prof = co_profile_find_str(profile_name, strlen(profile_name) + 1)), "Could not load profile."); 
+
+  /* Generated addresses are kept with the profile until it or the node id
+   * changes; the response gets a copy, since a change frees them */
+  if(co_id_get().id != _derived_id.id)
   {
-    if(co_profile_get_str(prof, &ipgen, "ipgen", sizeof("ipgen")) > 0)
-    {
-      if(!strcmp(ipgen, "true"))
-      {
-        if(co_profile_get_str(prof, &type, "type", sizeof("type")) > 0)
-        {
-          if(!strcmp(type, "ap") || !strcmp(type, "plug")) t = 1;
-        }
-        CHECK(co_profile_get_str(prof, &ipgenmask, "ipgenmask", sizeof("ipgenmask")) > 0, "Attempting to generate IP but ipgenmask not set.");
-        CHECK(co_profile_get_str(prof, &ip, "ip", sizeof("ip")) > 0, "Attempting to generate IP but ip not set.");
-        CHECK(co_generate_ip(ip, ipgenmask, co_id_get(), address, t), "Failed to generate IP.");
-        object = co_str8_create(address, sizeof(address), 0);
-        CHECK(object != NULL, "Failed to get property.");
-        co_tree_insert(*output, propname, proplen, object);
-        return 1;
-      }
-      else
-      {
-        object = co_profile_get(prof, prop);
-      }
-    }
-    else
-    {
-      object = co_profile_get(prof, prop);
-    }
+    co_profiles_clear_derived();
+    _derived_id = co_id_get();
   }
-  else if(!strcmp(propname, "bssid"))
+  if((object = co_profile_get_derived(prof, propname, proplen)) != NULL)
   {
-    if(co_profile_get_str(prof, &bssidgen, "bssidgen", sizeof("bssidgen")) > 0)
-    {
-      if(!strcmp(bssidgen, "true"))
-      {
-        CHECK(co_profile_get_str(prof, &ssid, "ssid", sizeof("ssid")) > 0, "Attempting to generate BSSID but SSID not set.");
-        CHECK(co_profile_get_str(prof, &chan, "channel", sizeof("channel")) > 0, "Attempting to generate BSSID but channel not set.");
-        unsigned int channel;
-        CHECK(sscanf(chan, "%u", &channel) > 0, "Failed to convert channel.");
-        DEBUG("Channel: %u", channel);
-        char bssid[BSSID_SIZE];
-        memset(bssid, '\0', sizeof(bssid));
-        get_bssid(ssid, channel, bssid);
-        char bssidstr[BSSID_STR_SIZE];
-        memset(bssidstr, '\0', sizeof(bssidstr));
-        CHECK(snprintfcat(bssidstr, BSSID_STR_SIZE, "%02x:%02x:%02x:%02x:%02x:%02x", bssid[0] & 0xff, bssid[1] & 0xff, bssid[2] & 0xff, bssid[3] & 0xff, bssid[4] & 0xff, bssid[5] & 0xff) > 0, "Failed to convert BSSID.");
-        DEBUG("BSSID: %s", bssidstr);
-        object = co_str8_create(bssidstr, strlen(bssidstr) + 1, 0);
-        CHECK(object != NULL, "Failed to get property.");
-        co_tree_insert(*output, propname, proplen, object);
-        return 1;
-      }
-      else
-      {
-        object = co_profile_get(prof, prop);
-      }
-    }
-    else
+    char *value = NULL;
+    ssize_t vlen = co_obj_data(&value, object);
+    co_tree_insert(*output, propname, proplen, co_str8_create(value, vlen, 0));
+    return 1;
+  }
+
+  if(!strcmp(propname, "ip") && co_profile_get_bool(prof, "ipgen", sizeof("ipgen")) == 1)
+  {
+    if(co_profile_get_str(prof, &type, "type", sizeof("type")) > 0)
     {
-      object = co_profile_get(prof, prop);
+      if(!strcmp(type, "ap") || !strcmp(type, "plug")) t = 1;
     }
+    CHECK(co_profile_get_ipv4(prof, "ipgenmask", sizeof("ipgenmask"), &ipgenmask), "Attempting to generate IP but ipgenmask not set.");
+    CHECK(co_profile_get_ipv4(prof, "ip", sizeof("ip"), &ip), "Attempting to generate IP but ip not set.");
+    CHECK(co_generate_ip_addr(ip, ipgenmask, co_id_get(), address, t), "Failed to generate IP.");
+    object = co_str8_create(address, sizeof(address), 0);
+    CHECK(object != NULL, "Failed to get property.");
+    co_tree_insert(*output, propname, proplen, object);
+    if(!co_profile_set_derived(prof, propname, proplen, co_str8_create(address, sizeof(address), 0)))
+      WARN("Failed to keep generated %s.", propname);
+    return 1;
   }
-  else
+  else if(!strcmp(propname, "bssid") && co_profile_get_bool(prof, "bssidgen", sizeof("bssidgen")) == 1)
   {
-    object = co_profile_get(prof, prop);
+    CHECK(co_profile_get_str(prof, &ssid, "ssid", sizeof("ssid")) > 0, "Attempting to generate BSSID but SSID not set.");
+    unsigned int channel = co_profile_get_uint(prof, "channel", sizeof("channel"));
+    CHECK(channel != (unsigned int)-1, "Attempting to generate BSSID but channel not set.");
+    DEBUG("Channel: %u", channel);
+    char bssid[BSSID_SIZE];
+    memset(bssid, '\0', sizeof(bssid));
+    get_bssid(ssid, channel, bssid);
+    char bssidstr[BSSID_STR_SIZE];
+    memset(bssidstr, '\0', sizeof(bssidstr));
+    CHECK(snprintfcat(bssidstr, BSSID_STR_SIZE, "%02x:%02x:%02x:%02x:%02x:%02x", bssid[0] & 0xff, bssid[1] & 0xff, bssid[2] & 0xff, bssid[3] & 0xff, bssid[4] & 0xff, bssid[5] & 0xff) > 0, "Failed to convert BSSID.");
+    DEBUG("BSSID: %s", bssidstr);
+    object = co_str8_create(bssidstr, strlen(bssidstr) + 1, 0);
+    CHECK(object != NULL, "Failed to get property.");
+    co_tree_insert(*output, propname, proplen, object);
+    if(!co_profile_set_derived(prof, propname, proplen, co_str8_create(bssidstr, strlen(bssidstr) + 1, 0)))
+      WARN("Failed to keep generated %s.", propname);
+    return 1;
   }
 
-  CHECK(object != NULL, "Failed to get property.");
-  co_tree_insert_unsafe(*output, propname, proplen, object);
+  CHECK(co_profile_insert_value(*output, prof, propname, proplen), "Failed to get property.");
   //co_obj_free(p);
   return 1;
 error:
@@ -566,11 +584,7 @@ CMD(get)
   char *kstr = NULL;
   ssize_t klen = co_obj_data(&kstr, co_list_element(params, 1));
   CHECK(klen > 0, "Invalid key.");
-  co_obj_t *kobj = co_str8_create(kstr, klen, 0);
-
-  co_obj_t *value = co_profile_get(prof, kobj);
-  CHECK(value != NULL, "Invalid value.");
-  co_tree_insert_unsafe(*output, kstr, klen, value);
+  CHECK(co_profile_insert_value(*output, prof, kstr, klen), "Invalid value.");
   return 1;
 
 error:
@@ -578,6 +592,164 @@ error:
   return 0;
 }
 
+/**
+ * @brief looks up a profile by name for mget/mset ("global" is the global profile)
+ * @param name profile name object
+ */
+static co_obj_t *
+_cmd_profile(co_obj_t *name)
+{
+  if(!co_str_cmp_str(name, "global")) return co_profile_global();
+  return co_profile_find(name);
+}
+
+CMD(mget)
+{
+  *output = co_tree16_create();
+  ssize_t plen = co_list_length(params);
+  CHECK(plen >= 2, "Incorrect parameters.");
+  co_obj_t *prof = _cmd_profile(co_list_element(params, 0));
+  if(prof == NULL)
+  {
+    co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Profile not found.", sizeof("Profile not found."), 0));
+    return 0;
+  }
+
+  char *kstr = NULL;
+  ssize_t klen = 0;
+  for(int i = 1; i < plen; i++)
+  {
+    klen = co_obj_data(&kstr, co_list_element(params, i));
+    CHECK(klen > 0, "Invalid key.");
+    CHECK(co_profile_insert_value(*output, prof, kstr, klen), "Invalid value.");
+  }
+  return 1;
+
+error:
+  co_obj_free(*output);
+  *output = co_tree16_create();
+  co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Incorrect profile mget parameters.", sizeof("Incorrect profile mget parameters."), 0));
+  return 0;
+}
+
+CMD(mset)
+{
+  *output = co_tree16_create();
+  ssize_t plen = co_list_length(params);
+  CHECK(plen >= 3 && plen % 2 == 1, "Incorrect parameters.");
+  co_obj_t *prof = _cmd_profile(co_list_element(params, 0));
+  if(prof == NULL)
+  {
+    co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Profile not found.", sizeof("Profile not found."), 0));
+    return 0;
+  }
+
+  char *kstr = NULL, *vstr = NULL, *pstr = NULL;
+  ssize_t klen = 0, vlen = 0;
+  int i = 0, j = 0;
+
+  /* Check every pair against the schema before touching the profile, so a
+   * bad key or value leaves it exactly as it was */
+  for(i = 1; i < plen; i += 2)
+  {
+    CHECK((klen = co_obj_data(&kstr, co_list_element(params, i))) > 0, "Invalid key.");
+    for(j = 1; j < i; j += 2)
+      CHECK(co_obj_data(&pstr, co_list_element(params, j)) != klen || memcmp(pstr, kstr, klen), "Duplicate key %s.", kstr);
+    CHECK((vlen = co_obj_data(&vstr, co_list_element(params, i + 1))) > 0, "Invalid value for key %s.", kstr);
+    CHECK(co_profile_check_str(prof, kstr, klen, vstr, vlen), "Invalid value %s for key %s.", vstr, kstr);
+  }
+  for(i = 1; i < plen; i += 2)
+  {
+    klen = co_obj_data(&kstr, co_list_element(params, i));
+    vlen = co_obj_data(&vstr, co_list_element(params, i + 1));
+    CHECK(co_profile_set_str(prof, kstr, klen, vstr, vlen), "Failed to set key %s to value %s.", kstr, vstr);
+    CHECK(co_profile_insert_value(*output, prof, kstr, klen), "Failed to read key %s.", kstr);
+  }
+  return 1;
+
+error:
+  co_obj_free(*output);
+  *output = co_tree16_create();
+  co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Incorrect profile mset parameters.", sizeof("Incorrect profile mset parameters."), 0));
+  return 0;
+}
+
+CMD(dump)
+{
+  *output = co_tree16_create();
+  CHECK(co_list_length(params) == 1, "Incorrect parameters.");
+  char *pstr = NULL;
+  ssize_t plen = co_obj_data(&pstr, co_list_element(params, 0));
+  CHECK(plen > 0, "Invalid profile name.");
+  co_obj_t *prof = _cmd_profile(co_list_element(params, 0));
+  if(prof == NULL)
+  {
+    co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Profile not found.", sizeof("Profile not found."), 0));
+    return 0;
+  }
+  co_obj_t *values = co_profile_values(prof);
+  CHECK(values != NULL, "Failed to read profile.");
+  co_tree_insert(*output, pstr, plen, values);
+  /* Where a following changes command picks up from */
+  co_tree_insert(*output, "version", sizeof("version"), co_uint64_create(co_profiles_version(), 0));
+  return 1;
+
+error:
+  co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Incorrect profile dump parameters.", sizeof("Incorrect profile dump parameters."), 0));
+  return 0;
+}
+
+static const char *_change_names[] = { "set", "add", "remove", "reload" };
+
+static void
+_cmd_changes_i(uint64_t version, int change, const char *name, const char *key, void *context)
+{
+  co_obj_t *entry = co_tree16_create(), *prof = NULL;
+  char value[UINT8_MAX + 1];
+  if(entry == NULL) return;
+  co_tree_insert(entry, "version", sizeof("version"), co_uint64_create(version, 0));
+  co_tree_insert(entry, "change", sizeof("change"), co_str8_create(_change_names[change], strlen(_change_names[change]) + 1, 0));
+  if(name != NULL)
+  {
+    co_tree_insert(entry, "profile", sizeof("profile"), co_str8_create(name, strlen(name) + 1, 0));
+    prof = strcmp(name, "global") ? co_profile_find_str(name, strlen(name) + 1) : co_profile_global();
+  }
+  if(key != NULL)
+  {
+    co_tree_insert(entry, "key", sizeof("key"), co_str8_create(key, strlen(key) + 1, 0));
+    /* The value now, which later changes in the list may have overwritten */
+    if(prof != NULL && co_profile_get_text(prof, key, strlen(key) + 1, value, sizeof(value)) > 0)
+      co_tree_insert(entry, "value", sizeof("value"), co_str8_create(value, strlen(value) + 1, 0));
+  }
+  if(!co_list_append((co_obj_t *)context, entry)) co_obj_free(entry);
+}
+
+CMD(changes)
+{
+  *output = co_tree16_create();
+  CHECK(co_list_length(params) == 1, "Incorrect parameters.");
+  char *sstr = NULL, *end = NULL;
+  CHECK(IS_STR(co_list_element(params, 0)) && co_obj_data(&sstr, co_list_element(params, 0)) > 0, "Incorrect parameters.");
+  errno = 0;
+  unsigned long long since = strtoull(sstr, &end, 10);
+  CHECK(errno == 0 && end != sstr && *end == '\0', "Invalid version %s.", sstr);
+
+  co_obj_t *changes = co_list16_create();
+  CHECK_MEM(changes);
+  if(!co_profiles_changes(since, _cmd_changes_i, changes))
+  {
+    /* Too old for the journal: the client has to dump the profiles again */
+    co_tree_insert(*output, "truncated", sizeof("truncated"), co_uint8_create(1, 0));
+  }
+  co_tree_insert(*output, "version", sizeof("version"), co_uint64_create(co_profiles_version(), 0));
+  co_tree_insert(*output, "changes", sizeof("changes"), changes);
+  return 1;
+
+error:
+  co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Incorrect changes parameters.", sizeof("Incorrect changes parameters."), 0));
+  return 0;
+}
+
 CMD(save)
 {
   *output = co_tree16_create();
@@ -700,8 +872,361 @@ error:
   return 0;
 }
 
+CMD(reload)
+{
+  *output = co_tree16_create();
+  ssize_t plen = co_list_length(params);
+  CHECK((plen == 1 || plen == 2) && IS_STR(co_list_element(params, plen - 1)), "Incorrect parameters.");
+  /* "profile <name>" names a profile even if it is called global */
+  CHECK(plen == 1 || !co_str_cmp_str(co_list_element(params, 0), "profile"), "Incorrect parameters.");
+
+  co_obj_t *name = co_list_element(params, plen - 1);
+  char *kstr = NULL;
+  ssize_t klen = co_obj_data(&kstr, name);
+  CHECK(klen > 0 && memchr(kstr, '/', klen) == NULL, "Invalid profile name.");
+  if(plen == 1 && !co_str_cmp_str(name, "global"))
+    CHECK(co_profile_reload_global(_config), "Failed to reload global configuration.");
+  else
+    CHECK(co_profile_reload(_profiles, kstr), "Failed to reload profile.");
+
+  co_tree_insert(*output, kstr, klen, co_str8_create("Reloaded.", sizeof("Reloaded."), 0));
+  return 1;
+error:
+  co_tree_insert(*output, "error", sizeof("error"), co_str8_create("Error reloading profile.", sizeof("Error reloading profile."), 0));
+  return 0;
+}
+
 int dispatcher_cb(co_obj_t *self, co_obj_t *context);
 
+/**
+ * @brief periodically hangs up idle clients of the management socket
+ * @param self timer whose ptr is the listening socket
+ */
+static int idle_timer_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params) {
+  co_timer_t *timer = (co_timer_t*)self;
+  int evicted = co_socket_evict_idle((co_obj_t*)timer->ptr, _idle_timeout);
+  if(evicted > 0) INFO("Evicted %d idle connections.", evicted);
+  /* Check at half the timeout; when exactly doesn't matter */
+  co_loop_set_timer_slack(self, _idle_timeout * 500, _idle_timeout * 500, NULL);
+  return 1;
+}
+
+/**
+ * @brief starts accepting on the management socket again after a pause
+ * @param self timer
+ */
+static int accept_timer_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params) {
+  if(_socket != NULL) co_socket_resume((co_obj_t*)_socket);
+  return 1;
+}
+
+/**
+ * @brief frees profiles replaced by reloads once no command that could
+ * point into them is running or has a response still to send
+ */
+static void profiles_collect(void) {
+  if(co_workers_busy() == 0) co_profiles_collect();
+}
+
+static int _watch = -1; /* inotify fd */
+static int _watch_profiles = -1;
+static int _watch_config = -1;
+
+/**
+ * @brief runs a deferred reload command on a worker thread
+ * @param context request list of command name and profile name
+ */
+static int profile_reload_work(void *context) {
+  co_obj_t *response = NULL;
+  int ret = co_cmd_exec(co_list_element(context, 0), &response, co_list_element(context, 1));
+  if(response != NULL) co_obj_free(response);
+  return ret;
+}
+
+static void profile_reload_done(void *context, int status) {
+  co_obj_free(context);
+  profiles_collect();
+}
+
+/**
+ * @brief reloads a profile through the reload command, so that it is
+ * serialized with every other command like a client request would be
+ * @param name profile name, or NULL for the global configuration
+ */
+static void profile_reload(const char *name) {
+  co_obj_t *request = co_list16_create();
+  co_obj_t *params = co_list16_create();
+  co_obj_t *response = NULL;
+  if(name == NULL)
+    co_list_append(params, co_str8_create("global", sizeof("global"), 0));
+  else
+  {
+    co_list_append(params, co_str8_create("profile", sizeof("profile"), 0));
+    co_list_append(params, co_str8_create(name, strlen(name) + 1, 0));
+  }
+  co_list_append(request, co_str8_create("reload", sizeof("reload"), 0));
+  co_list_append(request, params);
+  if(co_cmd_exec_nowait(co_list_element(request, 0), &response, params) < 0)
+  {
+    if(co_worker_submit(profile_reload_work, profile_reload_done, request)) return;
+    WARN("Worker queue full, profile %s not reloaded.", name ? name : "global");
+  }
+  if(response != NULL) co_obj_free(response);
+  co_obj_free(request);
+  profiles_collect();
+}
+
+/**
+ * @brief reloads profiles whose files changed, as reported by inotify
+ */
+static int profile_watch_cb(int fd, uint32_t revents, void *context) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const char *config = strrchr(_config, '/') ? strrchr(_config, '/') + 1 : _config;
+  ssize_t len = 0;
+
+  while((len = read(fd, buf, sizeof(buf))) > 0)
+  {
+    const struct inotify_event *event = NULL;
+    for(char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len)
+    {
+      event = (const struct inotify_event *)p;
+      if(event->mask & IN_Q_OVERFLOW) WARN("Profile change events lost; reload profiles by hand.");
+      /* Editors write dotfiles next to the one being saved */
+      if(event->len == 0 || event->name[0] == '.') continue;
+      if(event->wd == _watch_profiles)
+        profile_reload(event->name);
+      else if(event->wd == _watch_config && !strcmp(event->name, config))
+        profile_reload(NULL);
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief watches the profiles directory and the global configuration file's
+ * directory (files are often replaced by rename, which a watch on the file
+ * itself would not survive)
+ */
+static int profile_watch(void) {
+  const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+  char config_dir[PATH_MAX];
+  char *slash = NULL;
+
+  if((slash = strrchr(_config, '/')) == NULL)
+    snprintf(config_dir, sizeof(config_dir), ".");
+  else
+    snprintf(config_dir, sizeof(config_dir), "%.*s", slash == _config ? 1 : (int)(slash - _config), _config);
+
+  CHECK((_watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) != -1, "Failed to create inotify instance.");
+  CHECK((_watch_profiles = inotify_add_watch(_watch, _profiles, mask)) != -1, "Failed to watch %s.", _profiles);
+  if((_watch_config = inotify_add_watch(_watch, config_dir, mask)) == -1)
+    WARN("Failed to watch %s.", config_dir);
+  CHECK(co_loop_watch_fd(_watch, EPOLLIN, profile_watch_cb, NULL), "Failed to register inotify fd.");
+  return 1;
+error:
+  if(_watch != -1) close(_watch);
+  _watch = -1;
+  return 0;
+}
+
+static co_obj_t *profile_changed_i(co_obj_t *list, co_obj_t *iface, void *name) {
+  const co_iface_t *this_iface = (co_iface_t*)iface;
+  if(this_iface->profile != NULL && !strcmp(this_iface->profile, name))
+    INFO("Profile %s of interface %s changed; bring the interface up again to apply it.", (char *)name, this_iface->ifr.ifr_name);
+  return NULL;
+}
+
+/**
+ * @brief notifies interfaces configured from a profile that was reloaded
+ */
+static void profile_changed(const char *name, co_obj_t *profile, void *context) {
+  co_ifaces_parse(profile_changed_i, (void *)name);
+}
+
+/**
+ * @brief a command deferred to a worker thread, along with where to reply
+ */
+typedef struct dispatch_job_t {
+  co_socket_t *sock;
+  co_fd_t *fd;
+  uint32_t id;
+  co_cmd_t *cmd;
+  co_obj_t *request;
+  co_obj_t *response;
+  uint64_t received; // when the request arrived, for latency accounting
+} dispatch_job_t;
+
+/**
+ * @brief monotonic time in microseconds, for request latency
+ */
+static uint64_t dispatcher_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief encodes a command result and sends it back to the client
+ * @param sock dispatcher socket
+ * @param fd connected client
+ * @param id request ID the response answers
+ * @param ok whether the command succeeded
+ * @param response command output (error tree on failure, may be NULL)
+ */
+static void dispatcher_reply(co_socket_t *sock, co_obj_t *fd, uint32_t id, int ok, co_obj_t **response) {
+  char respbuf[RESPONSE_MAX];
+  memset(respbuf, '\0', sizeof(respbuf));
+  char *buf = respbuf, *grown = NULL;
+  size_t cap = sizeof(respbuf);
+  ssize_t resplen = 0;
+  co_obj_t *nil = co_nil_create(0);
+  CHECK_MEM(nil);
+
+  if(!ok && *response == NULL)
+  {
+    *response = co_tree16_create();
+    co_tree_insert(*response, "error", sizeof("error"), co_str8_create("Incorrect command.", sizeof("Incorrect command."), 0));
+  }
+  /* Most replies fit on the stack; bigger ones (dump) are encoded again
+   * into a heap buffer twice the size until they fit */
+  while((resplen = ok ? co_response_alloc(buf, cap, id, nil, *response) : co_response_alloc(buf, cap, id, *response, nil)) < 0)
+  {
+    CHECK(cap < RESPONSE_LIMIT, "Response too large.");
+    CHECK_MEM(grown = (buf == respbuf) ? h_malloc(cap * 2) : h_realloc(buf, cap * 2));
+    buf = grown;
+    cap *= 2;
+  }
+  sock->send(fd, buf, resplen);
+
+error:
+  if (buf != respbuf) h_free(buf);
+  if (nil) co_obj_free(nil);
+  return;
+}
+
+/**
+ * @brief runs a deferred command on a worker thread
+ * @param context dispatch_job_t of the request
+ */
+static int dispatcher_work(void *context) {
+  dispatch_job_t *job = context;
+  return co_cmd_run(job->cmd, &job->response, co_list_element(job->request, 3));
+}
+
+/**
+ * @brief sends a deferred command's response from the loop thread
+ * @param context dispatch_job_t of the request
+ * @param status return value of the command, -1 if it never ran
+ */
+static void dispatcher_done(void *context, int status) {
+  dispatch_job_t *job = context;
+  job->fd->pending--;
+  if(job->fd->fd == -1)
+  {
+    DEBUG("Client hung up before command completed.");
+    if(job->fd->pending == 0) co_obj_free((co_obj_t*)job->fd);
+  }
+  else
+  {
+    dispatcher_reply(job->sock, (co_obj_t*)job->fd, job->id, status > 0, &job->response);
+    co_fd_account((co_obj_t*)job->fd, dispatcher_now() - job->received);
+  }
+  co_obj_free(job->request);
+  if (job->response) co_obj_free(job->response);
+  h_free(job);
+  profiles_collect();
+  return;
+}
+
+/**
+ * @brief runs one request, inline or on the worker pool, and replies to it
+ * @param sock dispatcher socket
+ * @param fd connected client
+ * @param request imported request; freed here unless a worker takes it
+ * @param received when the read carrying the request arrived
+ */
+static void dispatcher_request(co_socket_t *sock, co_obj_t *fd, co_obj_t *request, const uint64_t received) {
+  co_obj_t *response = NULL;
+  uint8_t *type = NULL;
+  uint32_t *id = NULL;
+  dispatch_job_t *job = NULL;
+  co_cmd_t *cmd = NULL;
+  int status = 0;
+
+  CHECK(co_list_length(request) == 4, "Failed to import request.");
+  co_obj_data((char **)&type, co_list_element(request, 0)); 
+  CHECK(*type == 0, "Not a valid request.");
+  CHECK(co_obj_data((char **)&id, co_list_element(request, 1)) == sizeof(uint32_t), "Not a valid request ID.");
+  cmd = co_cmd_find(co_list_element(request, 2));
+
+  /* Credentials were cached at accept, so authorizing is just a flag test.
+   * Blocking commands, and anything arriving while one of them holds the
+   * command lock, go to the worker pool so the loop keeps turning. */
+  if(cmd == NULL)
+  {
+    response = co_tree16_create();
+    co_tree_insert(response, "error", sizeof("error"), co_str8_create("No such command.", sizeof("No such command."), 0));
+    status = 0;
+  }
+  else if(!((co_fd_t*)fd)->privileged && !(cmd->flags & CMD_PUBLIC))
+  {
+    WARN("Refusing privileged command from unprivileged client on FD %d.", ((co_fd_t*)fd)->fd);
+    response = co_tree16_create();
+    co_tree_insert(response, "error", sizeof("error"), co_str8_create("Permission denied.", sizeof("Permission denied."), 0));
+    status = 0;
+  }
+  else if((cmd->flags & CMD_BLOCKING) ||
+     (status = co_cmd_run_nowait(cmd, &response, co_list_element(request, 3))) < 0)
+  {
+    CHECK_MEM(job = h_calloc(1, sizeof(dispatch_job_t)));
+    job->sock = sock;
+    job->fd = (co_fd_t*)fd;
+    job->id = *id;
+    job->cmd = cmd;
+    job->request = request;
+    job->received = received;
+    if(co_worker_submit(dispatcher_work, dispatcher_done, job))
+    {
+      job->fd->pending++;
+      return;
+    }
+    h_free(job);
+    WARN("Worker queue full, rejecting request.");
+    response = co_tree16_create();
+    co_tree_insert(response, "error", sizeof("error"), co_str8_create("Server busy.", sizeof("Server busy."), 0));
+    status = 0;
+  }
+  dispatcher_reply(sock, fd, *id, status, &response);
+  co_fd_account(fd, dispatcher_now() - received);
+
+error:
+  if (request) co_obj_free(request);
+  if (response) co_obj_free(response);
+  profiles_collect();
+  return;
+}
+
+/**
+ * @brief keeps the unfinished tail of a read for the next one
+ * @param fd connected client
+ * @param data start of the partial request
+ * @param length bytes of it received so far
+ */
+static int dispatcher_keep(co_fd_t *fd, const char *data, const size_t length) {
+  if(length > fd->incap) {
+    char *buf = h_realloc(fd->inbuf, length);
+    CHECK_MEM(buf);
+    if(fd->inbuf == NULL) hattach(buf, fd);
+    fd->inbuf = buf;
+    fd->incap = length;
+  }
+  memmove(fd->inbuf, data, length);
+  fd->inlen = length;
+  return 1;
+error:
+  return 0;
+}
+
 /**
  * @brief sends/receives socket messages
  * @param self pointer to dispatcher socket struct
@@ -710,60 +1235,58 @@ int dispatcher_cb(co_obj_t *self, co_obj_t *context);
 int dispatcher_cb(co_obj_t *self, co_obj_t *fd) {
   CHECK(IS_SOCK(self),"Not a socket.");
   co_socket_t *sock = (co_socket_t*)self;
+  co_fd_t *client = (co_fd_t*)fd;
   char reqbuf[REQUEST_MAX];
   memset(reqbuf, '\0', sizeof(reqbuf));
-  ssize_t reqlen = 0;
-  char respbuf[RESPONSE_MAX];
-  memset(respbuf, '\0', sizeof(respbuf));
-  size_t resplen = 0;
-  co_obj_t *request = NULL, *response = NULL;
-  uint8_t *type = NULL;
-  uint32_t *id = NULL;
-  int ret = 0;
-  co_obj_t *nil = co_nil_create(0);
-  CHECK_MEM(nil);
+  ssize_t reqlen = 0, flen = 0;
+  size_t have = 0, offset = 0;
+  co_obj_t *request = NULL;
+  uint64_t received = dispatcher_now();
+
+  /* Pick up where a request split across reads left off */
+  if(client->inlen > 0) {
+    memmove(reqbuf, client->inbuf, client->inlen);
+    have = client->inlen;
+    client->inlen = 0;
+  }
 
   /* Incoming message on socket */
-  reqlen = sock->receive((co_obj_t*)sock, fd, reqbuf, sizeof(reqbuf));
+  reqlen = sock->receive((co_obj_t*)sock, fd, reqbuf + have, sizeof(reqbuf) - have);
   DEBUG("Received %d bytes.", (int)reqlen);
   if(reqlen == 0) {
     INFO("Received connection.");
-    co_obj_free(nil);
+    /* Ran out of descriptors; try again shortly */
+    if(client == sock->fd && client->paused && _accept_timer != NULL && !((co_timer_t*)_accept_timer)->pending)
+      co_loop_set_timer(_accept_timer, ACCEPT_BACKOFF, NULL);
     return 1;
   }
   if (reqlen < 0) {
     INFO("Connection recvd() -1");
     sock->hangup((co_obj_t*)sock, fd);
-    co_obj_free(nil);
     return 1;
   }
-  /* If it's a commotion message type, parse the header, target and payload */
-  CHECK(co_list_import(&request, reqbuf, reqlen) > 0 && co_list_length(request) == 4, "Failed to import request.");
-  co_obj_data((char **)&type, co_list_element(request, 0)); 
-  CHECK(*type == 0, "Not a valid request.");
-  CHECK(co_obj_data((char **)&id, co_list_element(request, 1)) == sizeof(uint32_t), "Not a valid request ID.");
-  if(co_cmd_exec(co_list_element(request, 2), &response, co_list_element(request, 3)))
-  {
-    resplen = co_response_alloc(respbuf, sizeof(respbuf), *id, nil, response);
-    sock->send(fd, respbuf, resplen);
+  have += reqlen;
+
+  /* A batch (co_call_batch) puts several requests in one read */
+  while(offset < have && (flen = co_message_length(reqbuf + offset, have - offset)) > 0) {
+    CHECK(co_list_import(&request, reqbuf + offset, flen) == flen, "Failed to import request.");
+    offset += flen;
+    dispatcher_request(sock, fd, request, received);
+    request = NULL;
   }
-  else
-  {
-    if(response == NULL)
-    {
-      response = co_tree16_create();
-      co_tree_insert(response, "error", sizeof("error"), co_str8_create("Incorrect command.", sizeof("Incorrect command."), 0));
-    }
-    resplen = co_response_alloc(respbuf, sizeof(respbuf), *id, response, nil);
-    sock->send(fd, respbuf, resplen);
+  CHECK(flen >= 0, "Malformed request.");
+  if(offset < have) {
+    CHECK(have - offset < sizeof(reqbuf), "Request too large.");
+    CHECK(dispatcher_keep(client, reqbuf + offset, have - offset), "Failed to keep partial request.");
   }
+  return 1;
 
-  ret = 1;
 error:
-  if (nil) co_obj_free(nil);
   if (request) co_obj_free(request);
-  if (response) co_obj_free(response);
-  return ret;
+  /* Nothing after a bad or oversized frame can be parsed, so drop the client */
+  if (IS_SOCK(self) && fd != (co_obj_t*)((co_socket_t*)self)->fd)
+    ((co_socket_t*)self)->hangup(self, fd);
+  return 0;
 }
 
  /**
@@ -857,7 +1380,8 @@ static void print_usage() {
           "\n"
           "Options:\n"
           " -c, --config <file>   Specify global config file.\n"
-          " -b, --bind <uri>      Specify management socket.\n"
+          " -b, --bind <uri>      Specify management socket (unix://, unix+seqpacket://\n"
+          "                       or tcp://).\n"
           " -d, --plugins <dir>   Specify plugin directory.\n"
           " -f, --profiles <dir>  Specify profile directory.\n"
           " -i, --id <nodeid>     Specify unique id number for this node.\n"
@@ -869,6 +1393,22 @@ static void print_usage() {
 }
 
 
+/**
+ * @brief copies a startup setting out of the global profile, which a reload
+ * replaces and frees
+ * @param settings global profile, or NULL to use the fallback
+ * @param key setting name
+ * @param klen key length
+ * @param fallback value used when the setting can't be read
+ */
+static char *setting_str(co_obj_t *settings, const char *key, const size_t klen, char *fallback) {
+  char *value = NULL, *copy = NULL;
+  if(settings == NULL || co_profile_get_str(settings, &value, key, klen) <= 0 || value == NULL)
+    return fallback;
+  if((copy = strdup(value)) == NULL) return fallback;
+  return copy;
+}
+
 /**
  * @brief Creates sockets for event loop, daemon and dispatcher. Starts/stops event loop.
  * 
@@ -939,49 +1479,35 @@ int main(int argc, char *argv[]) {
   if(!co_profile_import_global(_config)) WARN("Failed to load global configuration file %s!", _config);
   co_obj_t *settings = co_profile_global();
   
-  if(_pid == NULL)
-  {
-    if(settings != NULL)
-      co_profile_get_str(settings, &_pid, "pid", sizeof("pid"));
-    else
-      _pid = COMMOTION_PIDFILE;
-  }
+  if(_pid == NULL) _pid = setting_str(settings, "pid", sizeof("pid"), COMMOTION_PIDFILE);
   DEBUG("PID file: %s", _pid);
 
-  if(_bind == NULL)
+  if(_bind == NULL) _bind = setting_str(settings, "bind", sizeof("bind"), COMMOTION_MANAGESOCK);
+  DEBUG("Client socket: %s", _bind);
+  /* A UDP socket has one remote address for every sender, so deferred
+   * replies and later frames of a batch could go to the wrong client */
+  if(strncmp(_bind, "udp://", sizeof("udp://") - 1) == 0)
   {
-    if(settings != NULL)
-      co_profile_get_str(settings, &_bind, "bind", sizeof("bind"));
-    else
-      _bind = COMMOTION_MANAGESOCK;
+    ERROR("Cannot serve clients on %s, use a unix:// or tcp:// socket.", _bind);
+    exit(EXIT_FAILURE);
   }
-  DEBUG("Client socket: %s", _bind);
-  
-  if(_state == NULL)
+
+  if(settings != NULL)
   {
-    if(settings != NULL)
-      co_profile_get_str(settings, &_state, "state", sizeof("state"));
-    else
-      _state = COMMOTION_STATEDIR;
+    unsigned long limit = co_profile_get_uint(settings, "max_connections", sizeof("max_connections"));
+    if(limit != (unsigned long)-1) _max_connections = limit;
+    limit = co_profile_get_uint(settings, "idle_timeout", sizeof("idle_timeout"));
+    if(limit != (unsigned long)-1) _idle_timeout = limit;
   }
+  DEBUG("Connection limit: %lu, idle timeout: %lus", _max_connections, _idle_timeout);
+  
+  if(_state == NULL) _state = setting_str(settings, "state", sizeof("state"), COMMOTION_STATEDIR);
   DEBUG("State directory: %s", _state);
   
-  if(_plugins == NULL)
-  {
-    if(settings != NULL)
-      co_profile_get_str(settings, &_plugins, "plugins", sizeof("plugins"));
-    else
-      _plugins = COMMOTION_PLUGINDIR;
-  }
+  if(_plugins == NULL) _plugins = setting_str(settings, "plugins", sizeof("plugins"), COMMOTION_PLUGINDIR);
   DEBUG("Plugins directory: %s", _plugins);
 
-  if(_profiles == NULL)
-  {
-    if(settings != NULL)
-      co_profile_get_str(settings, &_profiles, "profiles", sizeof("profiles"));
-    else
-      _profiles = COMMOTION_PROFILEDIR;
-  }
+  if(_profiles == NULL) _profiles = setting_str(settings, "profiles", sizeof("profiles"), COMMOTION_PROFILEDIR);
   DEBUG("Profiles directory: %s", _profiles);
 
   /* If the daemon is needed, start the daemon */
@@ -991,27 +1517,38 @@ int main(int argc, char *argv[]) {
   co_plugins_init(16);
   co_cmds_init(16);
   co_loop_create(); /* Start event loop */
+  if(!co_workers_init(WORKER_THREADS, WORKER_QUEUE_MAX)) /* Start worker pool for blocking commands */
+    WARN("Failed to start worker pool, blocking commands will be rejected.");
   co_ifaces_create(); /* Configure interfaces */
   co_plugins_load(_plugins); /* Load plugins and register plugin profile schemas */
   co_profile_import_global(_config);
   SCHEMA_REGISTER(default); /* Register default schema */
-  co_profile_import_files(_profiles); /* Import profiles from profiles directory */
+  char cache[PATH_MAX];
+  snprintf(cache, sizeof(cache), "%s/%s", _state, PROFILE_CACHE);
+  co_profile_import_files_cached(_profiles, cache); /* Import profiles from profiles directory, reusing the compiled cache */
 
   /* Register commands */
-  CMD_REGISTER(help, "help <none>", "Print list of commands and usage information.");
-  CMD_REGISTER(profiles, "profiles <none>", "Print list of available profiles.");
-  CMD_REGISTER(up, "up <interface> <profile>", "Apply a configuration profile to an interface.");
-  CMD_REGISTER(down, "down <interface>", "Deconfigure a configured interface.");
-  CMD_REGISTER(status, "status <interface>", "Show configured profile for interface.");
+  CMD_REGISTER_FLAGS(help, "help <none>", "Print list of commands and usage information.", CMD_PUBLIC);
+  CMD_REGISTER_FLAGS(profiles, "profiles <none>", "Print list of available profiles.", CMD_PUBLIC);
+  CMD_REGISTER_FLAGS(up, "up <interface> <profile>", "Apply a configuration profile to an interface.", CMD_BLOCKING);
+  CMD_REGISTER_FLAGS(down, "down <interface>", "Deconfigure a configured interface.", CMD_BLOCKING);
+  CMD_REGISTER_FLAGS(status, "status <interface>", "Show configured profile for interface.", CMD_PUBLIC);
   CMD_REGISTER(state, "state <interface> <property>", "Show configured property for interface.");
   CMD_REGISTER(nodeid, "nodeid [<nodeid>] [mac <mac address>]", "Get or set node ID number.");
-  CMD_REGISTER(genip, "genip <subnet> <netmask> [gw]", "Generate IP address.");
-  CMD_REGISTER(genbssid, "genbssid <ssid> <channel>", "Generate a BSSID.");
+  CMD_REGISTER_FLAGS(genip, "genip <subnet> <netmask> [gw]", "Generate IP address.", CMD_PUBLIC);
+  CMD_REGISTER_FLAGS(genbssid, "genbssid <ssid> <channel>", "Generate a BSSID.", CMD_PUBLIC);
   CMD_REGISTER(get, "get <profile> <key>", "Get value from profile.");
   CMD_REGISTER(set, "set <profile> <key> <value>", "Set value to profile.");
+  CMD_REGISTER(mget, "mget <profile> <key> [<key> ...]", "Get several values from profile.");
+  CMD_REGISTER(dump, "dump <profile>", "Get every value in profile.");
+  CMD_REGISTER(changes, "changes <since-version>", "List profile changes made after a version.");
+  CMD_REGISTER(mset, "mset <profile> <key> <value> [<key> <value> ...]", "Set several values to profile, all or none.");
   CMD_REGISTER(save, "save <profile> [<filename>]", "Save profile to a file in the profiles directory.");
   CMD_REGISTER(new, "new <profile>", "Create a new profile.");
   CMD_REGISTER(delete, "delete <profile>", "Delete a profile.");
+  CMD_REGISTER(reload, "reload <profile>|global|profile <profile>", "Re-read a profile, or the global configuration, from its file.");
+  CMD_REGISTER_FLAGS(loopstats, "loopstats <none>", "Show event loop latency and wakeup statistics.", CMD_PUBLIC);
+  CMD_REGISTER_FLAGS(connections, "connections <none>", "Show traffic, request and latency counters for each client connection.", CMD_PUBLIC);
   
   struct sigaction sa = {{0}};
   sa.sa_handler = SIG_IGN; // handle socket errors gracefully
@@ -1021,13 +1558,26 @@ int main(int argc, char *argv[]) {
   }
   
   /* Set up sockets */
-  co_socket_t *socket = (co_socket_t*)NEW(co_socket, unix_socket);
+  co_socket_t *socket = (co_socket_t*)co_socket_create_uri(_bind);
+  _socket = socket;
   socket->poll_cb = dispatcher_cb;
   socket->register_cb = co_loop_add_socket;
+  socket->max_connections = _max_connections;
   socket->bind((co_obj_t*)socket, _bind);
+  if(_idle_timeout > 0)
+  {
+    co_obj_t *idle_timer = co_timer_create((struct timeval){0}, idle_timer_cb, socket);
+    co_timer_set_name(idle_timer, "idle");
+    co_loop_set_timer_slack(idle_timer, _idle_timeout * 500, _idle_timeout * 500, NULL);
+  }
+  _accept_timer = co_timer_create((struct timeval){0}, accept_timer_cb, NULL);
+  co_timer_set_name(_accept_timer, "accept");
+  co_profile_hook(profile_changed, NULL);
+  if(!profile_watch()) WARN("Profiles will not be reloaded when their files change.");
   co_plugins_start();
 
   co_loop_start();
+  co_workers_shutdown();
   co_loop_destroy();
   co_cmds_shutdown();
   co_profiles_shutdown();
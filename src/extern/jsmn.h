@@ -1,6 +1,8 @@
 #ifndef __JSMN_H_
 #define __JSMN_H_
 
+#include <stddef.h>
+
 /**
  * JSON type identifier. Basic types are:
  * 	o Object
@@ -58,10 +60,11 @@ typedef struct {
 void jsmn_init(jsmn_parser *parser);
 
 /**
- * Run JSON parser. It parses a JSON data string into and array of tokens, each describing
- * a single JSON object.
+ * Run JSON parser. It parses a JSON data string of at most len bytes into and array of
+ * tokens, each describing a single JSON object. If tokens is NULL, only counts the tokens
+ * needed. Returns the number of tokens or a negative jsmnerr_t.
  */
-jsmnerr_t jsmn_parse(jsmn_parser *parser, const char *js, 
+int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 		jsmntok_t *tokens, unsigned int num_tokens);
 
 #endif /* __JSMN_H_ */
@@ -435,13 +435,19 @@ int co_set_dns(const char *dnsserver, const char *searchdomain, const char *reso
 }
 
 int co_generate_ip(const char *base, const char *genmask, const nodeid_t id, char *output, int type) {
-  nodeid_t addr;
-  addr.id = 0;
   struct in_addr baseaddr;
-  struct in_addr generatedaddr;
   struct in_addr genmaskaddr;
   CHECK(inet_aton(base, &baseaddr) != 0, "Invalid base ip address %s", base); 
   CHECK(inet_aton(genmask, &genmaskaddr) != 0, "Invalid genmask address %s", genmask); 
+  return co_generate_ip_addr(baseaddr, genmaskaddr, id, output, type);
+error:
+  return 0;
+}
+
+int co_generate_ip_addr(const struct in_addr baseaddr, const struct in_addr genmaskaddr, const nodeid_t id, char *output, int type) {
+  nodeid_t addr;
+  addr.id = 0;
+  struct in_addr generatedaddr;
 
   /*
    * Turn the IP address into a 
@@ -487,8 +493,6 @@ int co_generate_ip(const char *base, const char *genmask, const nodeid_t id, cha
 
   strcpy(output, inet_ntoa(generatedaddr));
   return 1;
-error:
-  return 0;
 }
 
 char *co_iface_profile(char *iface_name) {
@@ -499,6 +503,13 @@ error:
   return NULL;
 }
 
+co_obj_t *co_ifaces_parse(co_iter_t iter, void *context) {
+  CHECK(ifaces != NULL, "Interfaces not initialized.");
+  return co_list_parse(ifaces, iter, context);
+error:
+  return NULL;
+}
+
 co_obj_t *co_iface_get(char *iface_name) {
   co_obj_t *iface = NULL;
   CHECK((iface = co_list_parse(ifaces, _co_iface_match_i, iface_name)) != NULL, "Failed to get interface %s!", iface_name);
@@ -34,6 +34,7 @@
 #define _IFACE_H
 #include <stdbool.h>
 #include <net/if.h>
+#include <netinet/in.h>
 #include "id.h"
 #include "obj.h"
 
@@ -207,6 +208,15 @@ int co_set_dns(const char *dnsserver, const char *searchdomain, const char *reso
  */
 int co_generate_ip(const char *base, const char *genmask, const nodeid_t id, char *output, int type);
 
+/**
+ * @brief generates an ip address like co_generate_ip, from parsed addresses
+ * @param baseaddr base address
+ * @param genmaskaddr genmask
+ * @param id the node id
+ * @param type whether the device is a gateway (1) or not (0)
+ */
+int co_generate_ip_addr(const struct in_addr baseaddr, const struct in_addr genmaskaddr, const nodeid_t id, char *output, int type);
+
 //int co_iface_status(const char *iface_name);
 
 /**
@@ -221,4 +231,11 @@ char *co_iface_profile(char *iface_name);
  */
 co_obj_t *co_iface_get(char *iface_name);
 
+/**
+ * @brief runs iter on each configured interface until it returns non-NULL
+ * @param iter iterator, called as for co_list_parse
+ * @param context pointer passed to iter
+ */
+co_obj_t *co_ifaces_parse(co_iter_t iter, void *context);
+
 #endif
@@ -40,11 +40,15 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 #include "debug.h"
 #include "process.h"
 #include "socket.h"
 #include "loop.h"
 #include "list.h"
+#include "tree.h"
 
 static co_obj_t *processes = NULL;
 static co_obj_t *sockets = NULL;
@@ -54,6 +58,51 @@ static bool loop_sigchld = false;
 static bool loop_exit = false;
 static int poll_fd = -1;
 
+/* Plain fd watchers. epoll hands back a pointer into this array instead of a
+ * co_fd_t, which is how _co_loop_poll_sockets tells the two apart. A slot is
+ * free while its callback is NULL. An unwatched slot is retired until the
+ * current batch of events is done, since the batch may still hold events for
+ * its old fd that would otherwise go to whatever reused it. */
+typedef struct co_watch_t {
+  int fd;
+  uint32_t events;
+  co_watch_cb_t cb;
+  void *context;
+  char name[16];
+  bool retired;
+} co_watch_t;
+
+static co_watch_t watches[LOOP_MAXWATCH];
+static int watches_retired = 0;
+
+/* Deferred callbacks, a fixed ring */
+typedef struct co_defer_t {
+  co_defer_cb_t cb;
+  void *context;
+} co_defer_t;
+
+static co_defer_t deferred[LOOP_MAXDEFER];
+static int defer_head = 0;
+static int defer_count = 0;
+
+/* Loop statistics. Fixed tables so recording never allocates; sockets are
+ * keyed by socket and named by URI, timers keyed and named by the name they
+ * were given, with the last slot of each table catching anything that
+ * doesn't fit. */
+typedef struct co_loop_stat_t {
+  const void *key;
+  char name[LOOP_STATNAME_MAX];
+  co_loop_hist_t hist;
+} co_loop_stat_t;
+
+static co_loop_stat_t socket_stats[LOOP_MAXSOCK];
+static co_loop_stat_t timer_stats[LOOP_MAXTIMER];
+static co_loop_hist_t lateness_hist;
+static co_loop_hist_t wakeups_hist;
+static co_loop_hist_t events_hist;
+static uint64_t wakeup_second = 0;
+static uint64_t wakeup_count = 0;
+
 //Private functions
 
 static void _co_loop_handle_signals(int sig) {
@@ -124,11 +173,12 @@ static co_obj_t *_co_loop_match_process_i(co_obj_t *list, co_obj_t *proc, void *
   return NULL;
 }
 
-static long _co_loop_tv_diff(const struct timeval *t1, const struct timeval *t2)
+/* microseconds from t2 to t1 */
+static int64_t _co_loop_tv_diff(const struct timeval *t1, const struct timeval *t2)
 {
   return
-  (t1->tv_sec - t2->tv_sec) * 1000 +
-  (t1->tv_usec - t2->tv_usec) / 1000;
+  (int64_t)(t1->tv_sec - t2->tv_sec) * 1000000 +
+  (t1->tv_usec - t2->tv_usec);
 }
 
 static co_obj_t *_co_loop_compare_timer_i(co_obj_t *list, co_obj_t *timer, void *time) {
@@ -172,29 +222,147 @@ static co_obj_t *_co_loop_destroy_process_i(co_obj_t *list, co_obj_t *proc, void
   return NULL;
 }
 
-static void _co_loop_poll_sockets(int deadline) {
+static uint64_t _co_loop_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _co_loop_hist_add(co_loop_hist_t *hist, uint64_t value) {
+  int bucket = 0;
+  while (value >> bucket && bucket < LOOP_HIST_BUCKETS - 1) bucket++;
+  hist->buckets[bucket]++;
+  hist->count++;
+  hist->sum += value;
+  if (value > hist->max) hist->max = value;
+}
+
+static co_loop_hist_t *_co_loop_stat_get(co_loop_stat_t *table, const int size, const void *key, const char *name) {
+  for (int i = 0; i < size - 1; i++)
+    if (table[i].key == key) return &table[i].hist;
+  /* New key, or an old name (a re-registered socket) under a new pointer */
+  for (int i = 0; i < size - 1; i++) {
+    if (table[i].name[0] == '\0' || strncmp(table[i].name, name, LOOP_STATNAME_MAX - 1) == 0) {
+      table[i].key = key;
+      snprintf(table[i].name, LOOP_STATNAME_MAX, "%s", name);
+      return &table[i].hist;
+    }
+  }
+  snprintf(table[size - 1].name, LOOP_STATNAME_MAX, "other");
+  return &table[size - 1].hist;
+}
+
+/* Forget a key that is going away, before its address can be reused */
+static void _co_loop_stat_drop(co_loop_stat_t *table, const int size, const void *key) {
+  for (int i = 0; i < size - 1; i++)
+    if (table[i].key == key) memset(&table[i], 0, sizeof(co_loop_stat_t));
+}
+
+static void _co_loop_count_wakeup(int n) {
+  uint64_t second = _co_loop_now_us() / 1000000;
+  if (second != wakeup_second) {
+    if (wakeup_second != 0) _co_loop_hist_add(&wakeups_hist, wakeup_count);
+    wakeup_second = second;
+    wakeup_count = 0;
+  }
+  wakeup_count++;
+  _co_loop_hist_add(&events_hist, n > 0 ? n : 0);
+}
+
+static co_obj_t *_co_loop_hist_tree(const co_loop_hist_t *hist) {
+  co_obj_t *tree = co_tree16_create(), *buckets = co_list16_create();
+  int last = LOOP_HIST_BUCKETS - 1;
+  /* Trailing empty buckets carry no information, leave them out */
+  while (last > 0 && hist->buckets[last] == 0) last--;
+  for (int i = 0; i <= last; i++)
+    co_list_append(buckets, co_uint32_create(hist->buckets[i], 0));
+  co_tree_insert(tree, "count", sizeof("count"), co_uint64_create(hist->count, 0));
+  co_tree_insert(tree, "sum", sizeof("sum"), co_uint64_create(hist->sum, 0));
+  co_tree_insert(tree, "max", sizeof("max"), co_uint64_create(hist->max, 0));
+  co_tree_insert(tree, "buckets", sizeof("buckets"), buckets);
+  return tree;
+}
+
+static co_obj_t *_co_loop_stat_tree(const co_loop_stat_t *table, const int size) {
+  co_obj_t *tree = co_tree16_create();
+  for (int i = 0; i < size; i++)
+    if (table[i].name[0] != '\0')
+      co_tree_insert(tree, table[i].name, strlen(table[i].name) + 1, _co_loop_hist_tree(&table[i].hist));
+  return tree;
+}
+
+static co_watch_t *_co_loop_find_watch(int fd) {
+  for (int i = 0; i < LOOP_MAXWATCH; i++)
+    if (watches[i].cb != NULL && watches[i].fd == fd) return &watches[i];
+  return NULL;
+}
+
+static bool _co_loop_is_watch(const void *ptr) {
+  return (const char*)ptr >= (const char*)watches && (const char*)ptr < (const char*)(watches + LOOP_MAXWATCH);
+}
+
+static void _co_loop_poll_watch(co_watch_t *watch, uint32_t revents) {
+  /* May have been unwatched by an earlier callback in this batch */
+  if (watch->cb == NULL) return;
+  uint64_t start = _co_loop_now_us();
+  watch->cb(watch->fd, revents, watch->context);
+  /* Keyed by fd rather than slot, since slots are reused for other fds */
+  _co_loop_hist_add(_co_loop_stat_get(socket_stats, LOOP_MAXSOCK, (void*)(intptr_t)(watch->fd + 1), watch->name), _co_loop_now_us() - start);
+}
+
+static void _co_loop_hangup(co_socket_t *sock, co_fd_t *fd) {
+  sock->hangup((co_obj_t*)sock, (co_obj_t*)fd);
+  /* With its own fd gone and no connections left, a socket has nothing for
+   * the loop to poll; whoever created it still owns it */
+  if (fd == sock->fd && sock->rfds == NULL)
+    co_loop_remove_socket((co_obj_t*)sock, NULL);
+}
+
+static void _co_loop_poll_sockets(int timeout) {
   co_socket_t *sock = NULL;
-  int timeout = deadline > 0 && deadline < LOOP_TIMEOUT ? deadline : LOOP_TIMEOUT;
+  co_fd_t *fd = NULL;
   int n = epoll_wait(poll_fd, events, LOOP_MAXEVENT, timeout);
-  
+  uint64_t start = 0;
+
+  _co_loop_count_wakeup(n);
   for(int i = 0; i < n; i++) {
-    sock = ((co_fd_t*)events[i].data.ptr)->socket;
+    if(_co_loop_is_watch(events[i].data.ptr)) {
+      _co_loop_poll_watch((co_watch_t*)events[i].data.ptr, events[i].events);
+      continue;
+    }
+    fd = (co_fd_t*)events[i].data.ptr;
+    sock = fd->socket;
     sock->events = events[i].events;
-    if((events[i].events & EPOLLERR) || 
-      (!(events[i].events & EPOLLIN))) {
-        WARN("EPOLL Error!");
-	close (((co_fd_t*)events[i].data.ptr)->fd);
-        continue;
+    if(events[i].events & EPOLLERR) {
+      WARN("EPOLL error on FD %d, hanging up.", fd->fd);
+      _co_loop_hangup(sock, fd);
     } else if(events[i].events & EPOLLHUP) {
       DEBUG("Hanging up socket.");
-      sock->hangup((co_obj_t*)sock, events[i].data.ptr);
-      sock->events = 0;
+      _co_loop_hangup(sock, fd);
     } else {
-      sock->poll_cb((co_obj_t*)sock, events[i].data.ptr);
-      sock->events = 0;
+      if(events[i].events & EPOLLOUT) {
+        if(co_socket_flush((co_obj_t*)fd) < 0) {
+          _co_loop_hangup(sock, fd);
+          sock->events = 0;
+          continue;
+        }
+        co_loop_update_socket((co_obj_t*)sock, (co_obj_t*)fd);
+      }
+      if((events[i].events & EPOLLIN) && !fd->throttled) {
+        start = _co_loop_now_us();
+        sock->poll_cb((co_obj_t*)sock, (co_obj_t*)fd);
+        _co_loop_hist_add(_co_loop_stat_get(socket_stats, LOOP_MAXSOCK, sock, sock->uri), _co_loop_now_us() - start);
+      }
     }
+    sock->events = 0;
   }
 
+  for(int i = 0; i < LOOP_MAXWATCH && watches_retired > 0; i++) {
+    if(watches[i].retired) {
+      watches[i].retired = false;
+      watches_retired--;
+    }
+  }
   return;
 }
 
@@ -208,6 +376,8 @@ static void _co_loop_poll_processes(void) {
 
 static void _co_loop_process_timers(struct timeval *now) {
   co_timer_t *timer = NULL;
+  uint64_t start = 0;
+  long late = 0;
   
   while (co_list_length(timers) > 0) {
     timer = (co_timer_t*)co_list_get_first(timers);
@@ -216,8 +386,14 @@ static void _co_loop_process_timers(struct timeval *now) {
     if (co_loop_remove_timer((co_obj_t*)timer,NULL) == 0) {
       ERROR("Failed to process timer %ld.%06ld",timer->deadline.tv_sec,timer->deadline.tv_usec);
     }
+    late = (now->tv_sec - timer->deadline.tv_sec) * 1000000 + (now->tv_usec - timer->deadline.tv_usec);
+    _co_loop_hist_add(&lateness_hist, late > 0 ? late : 0);
+    const char *name = timer->name ? timer->name : "unnamed";
+    co_loop_hist_t *hist = _co_loop_stat_get(timer_stats, LOOP_MAXTIMER, name, name);
     // call the timer's callback function:
+    start = _co_loop_now_us();
     timer->timer_cb((co_obj_t*)timer, NULL, NULL);
+    _co_loop_hist_add(hist, _co_loop_now_us() - start);
   }
 }
 
@@ -231,14 +407,49 @@ static void _co_loop_gettime(struct timeval *tv)
   tv->tv_usec = ts.tv_nsec / 1000;
 }
 
+typedef struct co_loop_wake_t {
+  const struct timeval *now;
+  int64_t wake; // us from now
+} co_loop_wake_t;
+
+static co_obj_t *_co_loop_earliest_wake_i(co_obj_t *list, co_obj_t *timer, void *context) {
+  if(!IS_TIMER(timer)) return NULL;
+  const co_timer_t *this_timer = (co_timer_t*)timer;
+  co_loop_wake_t *wake = context;
+  int64_t diff = _co_loop_tv_diff(&this_timer->deadline, wake->now);
+  /* Sorted by deadline, so no later timer can wake us any sooner */
+  if (diff >= wake->wake) return timer;
+  if (diff + this_timer->slack * 1000 < wake->wake) wake->wake = diff + this_timer->slack * 1000;
+  return NULL;
+}
+
+/** milliseconds until the loop must wake for timers, -1 if there are none */
 static int _co_loop_get_next_deadline(struct timeval *now) {
   co_timer_t *timer;
+  co_loop_wake_t wake = { now, 0 };
   
   if (co_list_length(timers) == 0)
-    return 0;
+    return -1;
   
   timer = (co_timer_t*)co_list_get_first(timers);
-  return _co_loop_tv_diff(&timer->deadline,now);
+  wake.wake = _co_loop_tv_diff(&timer->deadline,now) + timer->slack * 1000;
+  co_list_parse(timers, _co_loop_earliest_wake_i, &wake);
+  /* Rounded up: waking a fraction of a millisecond early would find nothing
+   * due and go straight back into a zero timeout */
+  if (wake.wake <= 0) return 0;
+  if (wake.wake >= (int64_t)INT_MAX * 1000) return INT_MAX;
+  return (wake.wake + 999) / 1000;
+}
+
+static void _co_loop_run_deferred(void) {
+  co_defer_t item;
+  /* Only what was queued before we started; the rest waits a turn */
+  for (int n = defer_count; n > 0; n--) {
+    item = deferred[defer_head];
+    defer_head = (defer_head + 1) % LOOP_MAXDEFER;
+    defer_count--;
+    item.cb(item.context);
+  }
 }
 
 //Public functions
@@ -282,11 +493,15 @@ int co_loop_destroy(void) {
   if(timers != NULL) {
     co_obj_free(timers);
   }
+  memset(watches, 0, sizeof(watches));
+  watches_retired = 0;
+  defer_head = defer_count = 0;
   return 1;
 }
 
 void co_loop_start(void) {
   struct timeval now;
+  int next = 0;
   _co_loop_setup_signals();
   //Main event loop.
   while(!loop_exit) {
@@ -294,7 +509,11 @@ void co_loop_start(void) {
     _co_loop_process_timers(&now);
     
     _co_loop_gettime(&now);
-    _co_loop_poll_sockets(_co_loop_get_next_deadline(&now));
+    next = _co_loop_get_next_deadline(&now);
+    if (defer_count > 0) next = 0;
+    else if (next < 0) next = LOOP_TIMEOUT;
+    _co_loop_poll_sockets(next);
+    _co_loop_run_deferred();
     //sleep(1);
 		if (loop_exit) break;
 		if (loop_sigchld) _co_loop_poll_processes();
@@ -302,6 +521,19 @@ void co_loop_start(void) {
   return;
 }
 
+co_obj_t *co_loop_stats(void) {
+  co_obj_t *stats = co_tree16_create();
+  CHECK_MEM(stats);
+  co_tree_insert(stats, "sockets", sizeof("sockets"), _co_loop_stat_tree(socket_stats, LOOP_MAXSOCK));
+  co_tree_insert(stats, "timers", sizeof("timers"), _co_loop_stat_tree(timer_stats, LOOP_MAXTIMER));
+  co_tree_insert(stats, "timer_lateness", sizeof("timer_lateness"), _co_loop_hist_tree(&lateness_hist));
+  co_tree_insert(stats, "wakeups_per_sec", sizeof("wakeups_per_sec"), _co_loop_hist_tree(&wakeups_hist));
+  co_tree_insert(stats, "events_per_wakeup", sizeof("events_per_wakeup"), _co_loop_hist_tree(&events_hist));
+  return stats;
+error:
+  return NULL;
+}
+
 void co_loop_stop(void) {
   loop_exit = true;
   return;
@@ -342,19 +574,23 @@ int co_loop_add_socket(co_obj_t *new_sock, co_obj_t *context) {
   if((node = co_list_parse(sockets, _co_loop_match_socket_i, sock->uri))) {
     CHECK((node == (co_obj_t*)sock), "Different socket with URI %s already registered.", sock->uri);
     if ((sock->listen) && (sock->fd->fd > 0) && sock->fd_registered) {
-      CHECK(co_list_contains(sock->rfd_lst,(co_obj_t*)fd),"Socket does not contain FD");
+      CHECK(fd->prev != NULL || sock->rfds == fd,"Socket does not contain FD");
       DEBUG("Adding RFD %d to epoll.", fd->fd);
       event.data.ptr = (co_obj_t*)fd;
       CHECK((epoll_ctl(poll_fd, EPOLL_CTL_ADD, fd->fd, &event)) != -1, "Failed to add receive FD epoll event.");
+      fd->events = event.events;
+      return 1;
     } else {
       SENTINEL("Socket %s already registered.", sock->uri);
     }
-  } else if((sock->listen) && (sock->fd->fd > 0) && !sock->fd_registered) {
+  } else if((sock->fd->fd > 0) && !sock->fd_registered) {
       CHECK(fd = sock->fd,"Invalid listening socket");
       DEBUG("Adding FD %d to epoll.", sock->fd->fd);
       event.data.ptr = (co_obj_t*)fd;
-      CHECK((epoll_ctl(poll_fd, EPOLL_CTL_ADD, sock->fd->fd, &event)) != -1, "Failed to add listen FD epoll event.");
+      CHECK((epoll_ctl(poll_fd, EPOLL_CTL_ADD, sock->fd->fd, &event)) != -1, "Failed to add FD epoll event.");
+      fd->events = event.events;
       sock->fd_registered = true; 
+      sock->update_cb = co_loop_update_socket;
       co_list_append(sockets, (co_obj_t*)sock);
       return 1;
   } else {
@@ -366,10 +602,32 @@ error:
   return 0;
 }
 
-static co_obj_t *_co_loop_remove_fd_i(co_obj_t *list, co_obj_t *fd, void *context) {
-  if (IS_FD(fd))
-    epoll_ctl(poll_fd, EPOLL_CTL_DEL, ((co_fd_t*)fd)->fd, NULL);
-  return NULL;
+int co_loop_update_socket(co_obj_t *self, co_obj_t *context) {
+  CHECK(IS_SOCK(self),"Not a socket.");
+  CHECK(IS_FD(context),"Not a FD.");
+  co_fd_t *fd = (co_fd_t*)context;
+  CHECK(fd->socket == (co_socket_t*)self,"FD does not match socket");
+  struct epoll_event event;
+
+  /* Hysteresis between the watermarks, so a client hovering around the limit
+   * doesn't flip its registration on every response. */
+  if(fd->outlen >= SOCKET_HIGHWATER) {
+    if(!fd->throttled) WARN("Slow client on FD %d: %zu bytes of output queued.", fd->fd, fd->outlen);
+    fd->throttled = true;
+  } else if(fd->outlen <= SOCKET_LOWWATER) fd->throttled = false;
+
+  memset(&event, 0, sizeof(struct epoll_event));
+  if(!fd->throttled && !fd->paused) event.events |= EPOLLIN;
+  if(fd->outlen > 0) event.events |= EPOLLOUT;
+  if(event.events == fd->events) return 1;
+
+  event.data.ptr = (co_obj_t*)fd;
+  CHECK((epoll_ctl(poll_fd, EPOLL_CTL_MOD, fd->fd, &event)) != -1, "Failed to modify FD %d epoll event.", fd->fd);
+  fd->events = event.events;
+  return 1;
+
+error:
+  return 0;
 }
 
 int co_loop_remove_socket(co_obj_t *old_sock, co_obj_t *context) {
@@ -378,8 +636,64 @@ int co_loop_remove_socket(co_obj_t *old_sock, co_obj_t *context) {
   CHECK((node = co_list_parse(sockets, _co_loop_match_socket_i, sock->uri)), "Failed to delete socket %s!", sock->uri);
   co_list_delete(sockets, node);
   sock->fd_registered = false; 
+  sock->update_cb = NULL;
   epoll_ctl(poll_fd, EPOLL_CTL_DEL, sock->fd->fd, NULL);
-  CHECK(co_list_parse(sock->rfd_lst,_co_loop_remove_fd_i,NULL) == NULL,"Failed to delete rfd_lst");
+  for(co_fd_t *rfd = sock->rfds; rfd != NULL; rfd = rfd->next)
+    epoll_ctl(poll_fd, EPOLL_CTL_DEL, rfd->fd, NULL);
+  _co_loop_stat_drop(socket_stats, LOOP_MAXSOCK, sock);
+  return 1;
+
+error:
+  return 0;
+}
+
+int co_loop_defer(co_defer_cb_t cb, void *context) {
+  CHECK(cb != NULL, "No deferred callback.");
+  CHECK(defer_count < LOOP_MAXDEFER, "Too many deferred callbacks.");
+  deferred[(defer_head + defer_count) % LOOP_MAXDEFER].cb = cb;
+  deferred[(defer_head + defer_count) % LOOP_MAXDEFER].context = context;
+  defer_count++;
+  return 1;
+error:
+  return 0;
+}
+
+int co_loop_watch_fd(int fd, uint32_t events, co_watch_cb_t cb, void *context) {
+  co_watch_t *watch = NULL;
+  struct epoll_event event;
+  int op = EPOLL_CTL_MOD;
+  CHECK(fd >= 0 && cb != NULL, "Invalid watcher.");
+
+  if (!(watch = _co_loop_find_watch(fd))) {
+    op = EPOLL_CTL_ADD;
+    for (int i = 0; i < LOOP_MAXWATCH && watch == NULL; i++)
+      if (watches[i].cb == NULL && !watches[i].retired) watch = &watches[i];
+    CHECK(watch != NULL, "Too many watched file descriptors.");
+  }
+
+  memset(&event, 0, sizeof(struct epoll_event));
+  event.events = events;
+  event.data.ptr = watch;
+  CHECK(epoll_ctl(poll_fd, op, fd, &event) != -1, "Failed to watch FD %d.", fd);
+  watch->fd = fd;
+  watch->events = events;
+  watch->cb = cb;
+  watch->context = context;
+  snprintf(watch->name, sizeof(watch->name), "fd:%d", fd);
+  return 1;
+
+error:
+  return 0;
+}
+
+int co_loop_unwatch_fd(int fd) {
+  co_watch_t *watch = NULL;
+  CHECK((watch = _co_loop_find_watch(fd)), "FD %d is not watched.", fd);
+  epoll_ctl(poll_fd, EPOLL_CTL_DEL, fd, NULL);
+  _co_loop_stat_drop(socket_stats, LOOP_MAXSOCK, (void*)(intptr_t)(fd + 1));
+  memset(watch, 0, sizeof(co_watch_t));
+  watch->retired = true;
+  watches_retired++;
   return 1;
 
 error:
@@ -404,7 +718,7 @@ int co_loop_add_timer(co_obj_t *new_timer, co_obj_t *context) {
   
   _co_loop_gettime(&now);
   CHECK(timer->timer_cb,"No callback function associated with timer");
-  CHECK(_co_loop_tv_diff(&timer->deadline,&now) > -1000,"Invalid timer deadline: %ld.%06ld  %ld.%06ld",
+  CHECK(_co_loop_tv_diff(&timer->deadline,&now) > -1000000,"Invalid timer deadline: %ld.%06ld  %ld.%06ld",
 	timer->deadline.tv_sec,timer->deadline.tv_usec,
 	now.tv_sec,now.tv_usec);
     
@@ -453,6 +767,11 @@ error:
   return NULL;
 }
 
+int co_loop_set_timer_slack(co_obj_t *old_timer, long msecs, long slack, co_obj_t *context) {
+  ((co_timer_t*)old_timer)->slack = slack > 0 ? slack : 0;
+  return co_loop_set_timer(old_timer, msecs, context);
+}
+
 int co_loop_set_timer(co_obj_t *old_timer, long msecs, co_obj_t *context) {
   co_timer_t *timer = (co_timer_t*)old_timer;
   struct timeval *deadline = &timer->deadline;
@@ -489,6 +808,15 @@ co_obj_t *co_timer_create(struct timeval deadline, co_cb_t timer_cb, void *ptr)
     new_timer->deadline = (struct timeval){0};
   new_timer->timer_cb = timer_cb ? timer_cb : NULL;
   new_timer->ptr = ptr ? ptr : (void*)new_timer;
+  new_timer->name = NULL;
   
   return (co_obj_t*)new_timer;
 }
+
+int co_timer_set_name(co_obj_t *timer, const char *name) {
+  CHECK(IS_TIMER(timer), "Not a timer.");
+  ((co_timer_t*)timer)->name = name;
+  return 1;
+error:
+  return 0;
+}
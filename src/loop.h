@@ -42,19 +42,51 @@
 #define LOOP_MAXEVENT 64
 #define LOOP_TIMEOUT 5
 #define LOOP_MAXTIMER 20
+#define LOOP_MAXWATCH 64
+#define LOOP_MAXDEFER 64
+#define LOOP_HIST_BUCKETS 24 /**< log2 buckets, the last one also counts anything larger */
+#define LOOP_STATNAME_MAX 64
 
 typedef struct co_timer_t co_timer_t;
 
+/**
+ * @brief callback for a watched file descriptor
+ * @param fd the watched file descriptor
+ * @param revents epoll events that fired (including EPOLLERR/EPOLLHUP)
+ * @param context pointer given to co_loop_watch_fd
+ */
+typedef int (*co_watch_cb_t)(int fd, uint32_t revents, void *context);
+
+/**
+ * @brief callback for deferred work
+ * @param context pointer given to co_loop_defer
+ */
+typedef void (*co_defer_cb_t)(void *context);
+
 struct co_timer_t {
   co_obj_t _header;
   uint8_t _exttype;
   uint8_t _len;
   bool pending;
   struct timeval deadline;
+  long slack; /**< ms the timer may fire after deadline, so it can share a wakeup with other timers */
   co_cb_t timer_cb;
   void *ptr;
+  const char *name; /**< what loopstats lists it under, NULL for "unnamed" */
 } __attribute__((packed));
 
+/**
+ * @struct co_loop_hist_t
+ * @brief a fixed-size log2 histogram; bucket 0 counts zero, bucket i counts
+ * values in [2^(i-1), 2^i)
+ */
+typedef struct co_loop_hist_t {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t buckets[LOOP_HIST_BUCKETS];
+} co_loop_hist_t;
+
 //Public functions
 
 /**
@@ -77,6 +109,14 @@ void co_loop_start(void);
  */
 void co_loop_stop(void);
 
+/**
+ * @brief builds a tree of loop statistics: poll_cb time per socket and
+ * timer_cb time per callback (microseconds), timer lateness (microseconds),
+ * epoll wakeups per second and events per wakeup
+ * @return a new tree, or NULL on error
+ */
+co_obj_t *co_loop_stats(void);
+
 /**
  * @brief adds a process to the event loop (for it to listen for)
  * @param proc the process to be added
@@ -96,6 +136,16 @@ int co_loop_remove_process(pid_t pid);
  */
 int co_loop_add_socket(co_obj_t *new_sock, co_obj_t *context);
 
+/**
+ * @brief recomputes the epoll events wanted by a registered file descriptor
+ * @details asks for EPOLLOUT while the fd has queued output, and stops reading
+ * from it while the queue is above SOCKET_HIGHWATER (until it drains to
+ * SOCKET_LOWWATER)
+ * @param self the socket owning the file descriptor
+ * @param context the co_fd_t to update
+ */
+int co_loop_update_socket(co_obj_t *self, co_obj_t *context);
+
 /**
  * @brief removes a socket from the event loop
  * @param old_sock the socket to be removed
@@ -110,6 +160,33 @@ int co_loop_remove_socket(co_obj_t *old_sock, co_obj_t *context);
  */
 co_obj_t *co_loop_get_socket(char *uri, co_obj_t *context);
 
+/**
+ * @brief watches a plain file descriptor, without wrapping it in a socket
+ * @details calling this again for a watched fd replaces its events, callback
+ * and context
+ * @param fd file descriptor to watch
+ * @param events epoll event mask (EPOLLIN, EPOLLOUT, ...)
+ * @param cb callback run when any of the events fire
+ * @param context pointer passed to the callback
+ */
+int co_loop_watch_fd(int fd, uint32_t events, co_watch_cb_t cb, void *context);
+
+/**
+ * @brief stops watching a file descriptor (without closing it)
+ * @param fd file descriptor passed to co_loop_watch_fd
+ */
+int co_loop_unwatch_fd(int fd);
+
+/**
+ * @brief queues a callback to run once, after I/O on the next loop iteration
+ * @details callbacks run in the order they were queued; ones queued by a
+ * deferred callback wait for the following iteration
+ * @param cb callback to run
+ * @param context pointer passed to the callback
+ * @return 0 if LOOP_MAXDEFER callbacks are already queued
+ */
+int co_loop_defer(co_defer_cb_t cb, void *context);
+
 /**
  * @brief schedules a new timer with the event loop
  * @param timer the timer to schedule
@@ -124,6 +201,17 @@ int co_loop_add_timer(co_obj_t *new_timer, co_obj_t *context);
  */
 int co_loop_remove_timer(co_obj_t *old_timer, co_obj_t *context);
 
+/**
+ * @brief sets timer to expire between msecs and msecs + slack from now
+ * @details the loop sleeps until the earliest deadline + slack of any timer,
+ * then fires every timer whose deadline has passed
+ * @param timer the timer to set
+ * @param msecs number of milliseconds
+ * @param slack number of milliseconds the timer may be delayed
+ * @param context a co_obj_t context pointer (currently unused)
+ */
+int co_loop_set_timer_slack(co_obj_t *timer, long msecs, long slack, co_obj_t *context);
+
 /**
  * @brief sets timer to expire in msecs from now
  * @param timer the timer to set
@@ -146,4 +234,12 @@ co_obj_t *co_loop_get_timer(void *ptr, co_obj_t *context);
  */
 co_obj_t *co_timer_create(struct timeval deadline, co_cb_t timer_cb, void *ptr);
 
+/**
+ * @brief names a timer for the loop's statistics
+ * @details timers sharing a name are counted together
+ * @param timer the timer to name
+ * @param name a string that outlives the timer, usually a literal
+ */
+int co_timer_set_name(co_obj_t *timer, const char *name);
+
 #endif
@@ -226,3 +226,100 @@ co_response_alloc(char *output, const size_t olen, const uint32_t id, const co_o
 error:
   return -1;
 }
+
+uint32_t
+co_request_id(const char *request)
+{
+  uint32_t id = 0;
+  const size_t offset = sizeof(_req_header.list_type) + sizeof(_req_header.list_len) + 
+    sizeof(_req_header.type_type) + sizeof(_req_header.type_value) + sizeof(_req_header.id_type);
+  memmove(&id, request + offset, sizeof(uint32_t));
+  return id;
+}
+
+/* Walks one object the way co_*_import() would read it, without building it */
+ssize_t
+co_message_length(const char *input, const size_t ilen)
+{
+  size_t read = 0, count = 0, i = 0;
+  ssize_t s = 0;
+  bool tree = false;
+  if(ilen < 1) return 0;
+  switch((uint8_t)input[0])
+  {
+    case _nil:
+    case _false:
+    case _true:
+      return 1;
+    case _uint8:
+    case _int8:
+      read = sizeof(uint8_t) + 1;
+      break;
+    case _uint16:
+    case _int16:
+      read = sizeof(uint16_t) + 1;
+      break;
+    case _uint32:
+    case _int32:
+    case _float32:
+      read = sizeof(uint32_t) + 1;
+      break;
+    case _uint64:
+    case _int64:
+    case _float64:
+      read = sizeof(uint64_t) + 1;
+      break;
+    case _str8:
+    case _bin8:
+      if(ilen < sizeof(uint8_t) + 1) return 0;
+      read = sizeof(uint8_t) + 1 + (uint8_t)(*(uint8_t *)(input + 1));
+      break;
+    case _str16:
+    case _bin16:
+      if(ilen < sizeof(uint16_t) + 1) return 0;
+      read = sizeof(uint16_t) + 1 + (uint16_t)(*(uint16_t *)(input + 1));
+      break;
+    case _str32:
+    case _bin32:
+      if(ilen < sizeof(uint32_t) + 1) return 0;
+      read = sizeof(uint32_t) + 1 + (uint32_t)(*(uint32_t *)(input + 1));
+      break;
+    case _ext16:
+      if(ilen < sizeof(uint8_t) + sizeof(uint16_t) + 1) return 0;
+      read = (uint16_t)*((uint16_t*)(input + sizeof(uint8_t) + 1)) + sizeof(uint8_t) + sizeof(uint16_t) + 1;
+      break;
+    case _tree16:
+      tree = true;
+      /* fall through */
+    case _list16:
+      if(ilen < sizeof(uint16_t) + 1) return 0;
+      count = *((uint16_t *)(input + 1));
+      read = sizeof(uint16_t) + 1;
+      break;
+    case _tree32:
+      tree = true;
+      /* fall through */
+    case _list32:
+      if(ilen < sizeof(uint32_t) + 1) return 0;
+      count = *((uint32_t *)(input + 1));
+      read = sizeof(uint32_t) + 1;
+      break;
+    default:
+      return -1;
+  }
+  for(i = 0; i < count; i++)
+  {
+    if(tree)
+    {
+      /* Tree keys are always str8 */
+      if(read + sizeof(uint8_t) + 1 > ilen) return 0;
+      if((uint8_t)input[read] != _str8) return -1;
+      read += sizeof(uint8_t) + 1 + (uint8_t)input[read + 1];
+    }
+    if(read >= ilen) return 0;
+    if((s = co_message_length(input + read, ilen - read)) <= 0) return s;
+    read += s;
+  }
+  if(read > ilen) return 0;
+  return read;
+}
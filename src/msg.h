@@ -57,4 +57,20 @@ size_t co_request_alloc(char *output, const size_t olen, const co_obj_t *method,
  */
 size_t co_response_alloc(char *output, const size_t olen, const uint32_t id, const co_obj_t *error, co_obj_t *result);
 
+/**
+ * @brief reads the ID of a request packed by co_request_alloc
+ * @param request packed request
+ */
+uint32_t co_request_id(const char *request);
+
+/**
+ * @brief measures the first packed message in a buffer that may hold
+ * several, or only part of one
+ * @param input buffer of packed messages
+ * @param ilen number of bytes in buffer
+ * @return length of the first message, 0 if it isn't all there yet, -1 if
+ * it is malformed
+ */
+ssize_t co_message_length(const char *input, const size_t ilen);
+
 #endif
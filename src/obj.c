@@ -211,7 +211,7 @@ _DEFINE_STR(32);
       output->_type = _##T##L; \
       output->_flags = flags; \
       output->_ref = 0; \
-      (((co_##T##L##_t *)output)->data) = (uint32_t)input; \
+      (((co_##T##L##_t *)output)->data) = (T##L##_t)input; \
       return 1; \
     } \
   co_obj_t *co_##T##L##_create(\
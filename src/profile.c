@@ -33,7 +33,17 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
 #include "obj.h"
 #include "list.h"
 #include "tree.h"
@@ -41,13 +51,48 @@
 #include "util.h"
 #include "profile.h"
 #include "extern/jsmn.h"
-
-#define DEFAULT_TOKENS 128
+#include "extern/md5.h"
 
 static co_obj_t *_profiles = NULL;
+static co_obj_t *_profile_index = NULL; /* same profiles, by name; values inserted unsafe */
+static co_obj_t *_profiles_retired = NULL; /* replaced by a reload; kept until co_profiles_collect, since responses may still point into them */
+static co_obj_t *_templates_retired = NULL; /* stale templates, which profiles created with them still point at */
+
+static struct {
+  co_profile_hook_t cb;
+  void *context;
+} _profile_hooks[PROFILE_HOOKS_MAX];
+static int _profile_nhooks = 0;
 static co_obj_t *_schemas = NULL;
 static co_obj_t *_profile_global = NULL;
 static co_obj_t *_schemas_global = NULL;
+static co_obj_t *_template = NULL; /* compiled _schemas defaults, shared read-only by profiles */
+static co_obj_t *_template_global = NULL;
+static co_obj_t *_schema_choices = NULL; /* allowed values of enum keys, separated by '|' */
+
+/* Ring of the last PROFILE_JOURNAL_MAX changes; the change producing
+ * version v is kept at v % PROFILE_JOURNAL_MAX */
+static struct {
+  uint64_t version;
+  int change;
+  co_obj_t *name;
+  co_obj_t *key;
+} _profile_journal[PROFILE_JOURNAL_MAX];
+static uint64_t _profile_version = 0; /* starts at the boot epoch, see co_profiles_init */
+
+/* Longest text form of a typed (non-string) value */
+#define PROFILE_TEXT_MAX 32
+
+/* Profiles keep pointing at the template they were created with, so one
+ * made stale by a new schema is retired rather than freed */
+static void
+_co_template_invalidate(co_obj_t **tmpl)
+{
+  if(*tmpl == NULL) return;
+  if(_templates_retired == NULL || !co_list_append(_templates_retired, *tmpl))
+    WARN("Leaking stale schema template.");
+  *tmpl = NULL;
+}
 
 static co_obj_t *
 _co_schema_create(co_cb_t cb)
@@ -71,6 +116,7 @@ co_schema_register(co_cb_t cb)
 {
   DEBUG("Registering schema.");
   CHECK(co_list_append(_schemas, _co_schema_create(cb)), "Failed to register schema.");
+  _co_template_invalidate(&_template);
   return 1;
 error:
   return 0;
@@ -81,43 +127,362 @@ co_schema_register_global(co_cb_t cb)
 {
   DEBUG("Registering global schema.");
   CHECK(co_list_append(_schemas_global, _co_schema_create(cb)), "Failed to register schema.");
+  _co_template_invalidate(&_template_global);
+  return 1;
+error:
+  return 0;
+}
+
+/* Whether value is one of the choices declared for an enum key */
+static int
+_co_profile_choice(const char *key, const size_t klen, const char *value, const size_t vlen)
+{
+  _treenode_t *n = co_tree_find_node(co_tree_root(_schema_choices), key, klen);
+  char *c = NULL;
+  size_t len = strnlen(value, vlen);
+  ssize_t clen = 0;
+
+  CHECK(n != NULL && co_node_value(n) != NULL, "No choices for %s.", key);
+  CHECK((clen = co_obj_data(&c, co_node_value(n))) > 0, "Invalid choices for %s.", key);
+  clen = strnlen(c, clen);
+  for(ssize_t i = 0, start = 0; i <= clen; i++)
+  {
+    if(i < clen && c[i] != '|') continue;
+    if((size_t)(i - start) == len && !memcmp(c + start, value, len)) return 1;
+    start = i + 1;
+  }
+error:
+  return 0;
+}
+
+/* Converts the text form of a value into an object of the given type */
+static co_obj_t *
+_co_profile_parse(const int type, const char *key, const char *value, const size_t vlen)
+{
+  const uint8_t flags = type << 4;
+  char text[PROFILE_TEXT_MAX];
+  char *end = NULL;
+  unsigned long u = 0;
+  struct in_addr addr;
+  unsigned char mac[PROFILE_MAC_SIZE];
+  int n = 0;
+
+  if(type == PROFILE_STR || type == PROFILE_ENUM)
+    return co_str8_create(value, vlen, flags);
+
+  CHECK(strnlen(value, vlen) < sizeof(text), "Value of %s too long.", key);
+  snprintf(text, sizeof(text), "%.*s", (int)strnlen(value, vlen), value);
+  switch(type)
+  {
+    case PROFILE_BOOL:
+      if(!strcmp(text, "true") || !strcmp(text, "yes") || !strcmp(text, "1"))
+        return co_bool_create(true, flags);
+      if(!strcmp(text, "false") || !strcmp(text, "no") || !strcmp(text, "0"))
+        return co_bool_create(false, flags);
+      SENTINEL("Value %s of %s is not a boolean.", text, key);
+    case PROFILE_UINT:
+      errno = 0;
+      u = strtoul(text, &end, 10);
+      CHECK(text[0] >= '0' && text[0] <= '9' && *end == '\0' && errno == 0 && u <= UINT32_MAX,
+          "Value %s of %s is not an unsigned integer.", text, key);
+      return co_uint32_create(u, flags);
+    case PROFILE_IPV4:
+      CHECK(inet_pton(AF_INET, text, &addr) == 1, "Value %s of %s is not an IPv4 address.", text, key);
+      return co_uint32_create(addr.s_addr, flags);
+    case PROFILE_MAC:
+      CHECK(sscanf(text, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx%n", &mac[0], &mac[1], &mac[2],
+            &mac[3], &mac[4], &mac[5], &n) == PROFILE_MAC_SIZE && text[n] == '\0',
+          "Value %s of %s is not a MAC address.", text, key);
+      return co_bin8_create((char *)mac, sizeof(mac), flags);
+    default:
+      SENTINEL("Unknown type %d for %s.", type, key);
+  }
+error:
+  return NULL;
+}
+
+static unsigned long
+_co_profile_uint(const co_obj_t *obj)
+{
+  switch(CO_TYPE(obj))
+  {
+    case _uint8:
+      return ((co_uint8_t *)obj)->data;
+    case _uint16:
+      return ((co_uint16_t *)obj)->data;
+    case _uint32:
+      return ((co_uint32_t *)obj)->data;
+    case _uint64:
+      return ((co_uint64_t *)obj)->data;
+    default:
+      return 0;
+  }
+}
+
+/* Writes the text form of a value of the given type, as imported and
+ * exported; returns its length including the NUL */
+static ssize_t
+_co_profile_format(const co_obj_t *value, const int type, char *output, const size_t size)
+{
+  char *data = NULL;
+  ssize_t len = 0;
+  struct in_addr addr;
+
+  switch(type)
+  {
+    case PROFILE_BOOL:
+      CHECK(IS_BOOL(value), "Value is not a boolean.");
+      len = snprintf(output, size, "%s", IS_TRUE(value) ? "true" : "false");
+      break;
+    case PROFILE_UINT:
+      CHECK(IS_UINT(value), "Value is not an unsigned integer.");
+      len = snprintf(output, size, "%lu", _co_profile_uint(value));
+      break;
+    case PROFILE_IPV4:
+      CHECK(IS_UINT(value), "Value is not an address.");
+      addr.s_addr = _co_profile_uint(value);
+      CHECK(inet_ntop(AF_INET, &addr, output, size) != NULL, "Failed to format address.");
+      len = strlen(output);
+      break;
+    case PROFILE_MAC:
+      CHECK(IS_BIN(value) && co_obj_data(&data, value) == PROFILE_MAC_SIZE, "Value is not a MAC address.");
+      len = snprintf(output, size, "%02X:%02X:%02X:%02X:%02X:%02X", data[0] & 0xff, data[1] & 0xff,
+          data[2] & 0xff, data[3] & 0xff, data[4] & 0xff, data[5] & 0xff);
+      break;
+    default:
+      CHECK(IS_STR(value), "Value is not a string.");
+      len = co_obj_data(&data, value);
+      len = snprintf(output, size, "%.*s", (int)strnlen(data, len), data);
+      break;
+  }
+  CHECK(len >= 0 && (size_t)len < size, "Value too long.");
+  return len + 1;
+error:
+  return -1;
+}
+
+int
+co_schema_add(co_obj_t *self, const char *key, const size_t klen, const char *value, const size_t vlen, const int type, const char *choices, const size_t clen)
+{
+  co_obj_t *def = NULL, *c = NULL;
+  CHECK(IS_TREE(self), "Not a schema.");
+  if(choices != NULL)
+  {
+    if(_schema_choices == NULL)
+      CHECK_MEM(_schema_choices = co_tree16_create());
+    CHECK_MEM(c = co_str8_create(choices, clen, 0));
+    CHECK(co_tree_insert_force(_schema_choices, key, klen, c), "Failed to add choices for %s.", key);
+    c = NULL;
+  }
+  CHECK(type != PROFILE_ENUM || _co_profile_choice(key, klen, value, vlen), "Default %s of %s is not a choice.", value, key);
+  CHECK((def = _co_profile_parse(type, key, value, vlen)) != NULL, "Invalid default for %s.", key);
+  if(!co_tree_insert(self, key, klen, def))
+    co_obj_free(def);
   return 1;
 error:
+  if(c != NULL) co_obj_free(c);
   return 0;
 }
 
 static co_obj_t *
 _co_schemas_load_i(co_obj_t *list, co_obj_t *current, void *context) 
 {
-  if(IS_CBPTR(current) && IS_PROFILE(context) && (((co_cbptr_t *)current)->cb != NULL))
+  if(IS_CBPTR(current) && IS_TREE(context) && (((co_cbptr_t *)current)->cb != NULL))
   {
     DEBUG("Running schema callback.");
-    ((co_cbptr_t *)current)->cb(((co_profile_t *)context)->data, NULL, NULL);
+    ((co_cbptr_t *)current)->cb(context, NULL, NULL);
   }
   return NULL;
 }
 
+/* Runs every schema callback once, into the tree profiles of that kind
+ * fall back to for keys they don't set themselves */
+static co_obj_t *
+_co_schemas_template(co_obj_t *schemas)
+{
+  co_obj_t **tmpl = (schemas == _schemas_global) ? &_template_global : &_template;
+  if(*tmpl == NULL)
+  {
+    DEBUG("Compiling schema template.");
+    CHECK_MEM(*tmpl = co_tree16_create());
+    co_list_parse(schemas, _co_schemas_load_i, *tmpl);
+  }
+  return *tmpl;
+error:
+  return NULL;
+}
+
 static int
 _co_schemas_load(co_obj_t *profile, co_obj_t *schemas) 
 {
   CHECK(IS_PROFILE(profile), "Not a valid search index.");
   CHECK(schemas != NULL, "Schemas not initialized.");
-  co_list_parse(schemas, _co_schemas_load_i, profile);
+  CHECK((((co_profile_t *)profile)->defaults = _co_schemas_template(schemas)) != NULL, "Failed to compile schemas.");
   return 1;
 error:
   return 0;
 }
 
+/* Looks a key up in the profile's own values, then in its schema defaults */
+static co_obj_t *
+_co_profile_lookup(const co_obj_t *profile, const char *key, const size_t klen)
+{
+  const co_profile_t *p = (const co_profile_t *)profile;
+  _treenode_t *n = co_tree_find_node(co_tree_root(p->data), key, klen);
+  if((n == NULL || co_node_value(n) == NULL) && p->defaults != NULL)
+    n = co_tree_find_node(co_tree_root(p->defaults), key, klen);
+  return n != NULL ? co_node_value(n) : NULL;
+}
+
+/* Declared type of a key, read off its schema default; -1 if not in schema */
+static int
+_co_profile_type(const co_obj_t *profile, const char *key, const size_t klen)
+{
+  const co_profile_t *p = (const co_profile_t *)profile;
+  _treenode_t *n = co_tree_find_node(co_tree_root(p->defaults), key, klen);
+  if(n == NULL || co_node_value(n) == NULL) return -1;
+  return PROFILE_TYPE(co_node_value(n));
+}
+
+static void
+_co_profile_clear_derived(co_obj_t *profile)
+{
+  co_profile_t *p = (co_profile_t *)profile;
+  if(p->derived == NULL) return;
+  co_obj_free(p->derived);
+  p->derived = NULL;
+}
+
+/* Forgets where the profile was last saved, so the next export writes it */
+static void
+_co_profile_unsave(co_obj_t *profile)
+{
+  co_profile_t *p = (co_profile_t *)profile;
+  if(p->saved == NULL) return;
+  co_obj_free(p->saved);
+  p->saved = NULL;
+}
+
+/* Bumps the profiles version and journals the change; key is NULL unless a
+ * value was set. Running out of memory only loses the names, so readers
+ * still see that something changed. */
+static uint64_t
+_co_profile_journal(const int change, const char *name, const size_t nlen, const char *key, const size_t klen)
+{
+  char buf[UINT8_MAX];
+  int i = ++_profile_version % PROFILE_JOURNAL_MAX;
+  if(_profile_journal[i].name != NULL) co_obj_free(_profile_journal[i].name);
+  if(_profile_journal[i].key != NULL) co_obj_free(_profile_journal[i].key);
+  _profile_journal[i].version = _profile_version;
+  _profile_journal[i].change = change;
+  snprintf(buf, sizeof(buf), "%.*s", (int)nlen, name);
+  _profile_journal[i].name = co_str8_create(buf, strlen(buf) + 1, 0);
+  _profile_journal[i].key = NULL;
+  if(key != NULL)
+  {
+    snprintf(buf, sizeof(buf), "%.*s", (int)klen, key);
+    _profile_journal[i].key = co_str8_create(buf, strlen(buf) + 1, 0);
+  }
+  return _profile_version;
+}
+
+static void
+_co_profile_journal_clear(void)
+{
+  for(int i = 0; i < PROFILE_JOURNAL_MAX; i++)
+  {
+    if(_profile_journal[i].name != NULL) co_obj_free(_profile_journal[i].name);
+    if(_profile_journal[i].key != NULL) co_obj_free(_profile_journal[i].key);
+  }
+  memset(_profile_journal, 0, sizeof(_profile_journal));
+  _profile_version = 0;
+}
+
+/* Only profiles readers can see are versioned; ones still being loaded or
+ * built to replace another are not */
+static int
+_co_profile_registered(co_obj_t *profile)
+{
+  char *name = NULL;
+  ssize_t nlen = 0;
+  if(profile == _profile_global) return 1;
+  if(_profile_index == NULL) return 0;
+  nlen = co_obj_data(&name, ((co_profile_t *)profile)->name);
+  if(nlen <= 0) return 0;
+  return co_tree_find(_profile_index, name, strnlen(name, nlen)) == profile;
+}
+
+/* Drops everything derived from the profile's old values and where it was
+ * last saved, and journals the key that changed */
+static void
+_co_profile_changed(co_obj_t *profile, const char *key, const size_t klen)
+{
+  co_profile_t *p = (co_profile_t *)profile;
+  char *name = NULL;
+  ssize_t nlen = 0;
+  _co_profile_clear_derived(profile);
+  _co_profile_unsave(profile);
+  if(!_co_profile_registered(profile)) return;
+  nlen = co_obj_data(&name, p->name);
+  p->version = _co_profile_journal(PROFILE_CHANGE_SET, name, nlen, key, klen);
+}
+
+/* Copies a default into the profile's own values so it can be overwritten
+ * without touching the shared template; returns the tree now holding it */
+static co_obj_t *
+_co_profile_own(co_obj_t *profile, const char *key, const size_t klen)
+{
+  co_profile_t *p = (co_profile_t *)profile;
+  co_obj_t *def = NULL, *copy = NULL;
+  char *raw = NULL;
+  ssize_t rlen = 0;
+  _treenode_t *n = co_tree_find_node(co_tree_root(p->data), key, klen);
+
+  if(n != NULL && co_node_value(n) != NULL) return p->data;
+  CHECK(p->defaults != NULL, "Profile has no schema.");
+  n = co_tree_find_node(co_tree_root(p->defaults), key, klen);
+  CHECK(n != NULL && (def = co_node_value(n)) != NULL, "No key %s in schema.", key);
+  CHECK((rlen = co_obj_raw(&raw, def)) > 0, "Failed to read default %s.", key);
+  CHECK(co_obj_import(&copy, raw, rlen, co_obj_getflags(def)) > 0, "Failed to copy default %s.", key);
+  CHECK(co_tree_insert_force(p->data, key, klen, copy), "Failed to add %s to profile.", key);
+  return p->data;
+error:
+  if(copy != NULL) co_obj_free(copy);
+  return NULL;
+}
+
 void 
 co_profiles_shutdown(void) 
 {
   if(_profiles != NULL) co_obj_free(_profiles);
+  if(_profile_index != NULL) co_obj_free(_profile_index);
+  if(_profiles_retired != NULL) co_obj_free(_profiles_retired);
+  if(_templates_retired != NULL) co_obj_free(_templates_retired);
   if(_profile_global != NULL) co_obj_free(_profile_global);
   if(_schemas != NULL) co_obj_free(_schemas);
   if(_schemas_global != NULL) co_obj_free(_schemas_global);
+  if(_template != NULL) co_obj_free(_template);
+  if(_template_global != NULL) co_obj_free(_template_global);
+  if(_schema_choices != NULL) co_obj_free(_schema_choices);
+  _profiles = _profile_index = _profiles_retired = _templates_retired = _profile_global = NULL;
+  _schemas = _schemas_global = _template = _template_global = _schema_choices = NULL;
+  _co_profile_journal_clear();
   return;
 }
 
+void
+co_profiles_collect(void)
+{
+  co_obj_t *retired = NULL;
+  if(_profiles_retired == NULL || co_list_length(_profiles_retired) == 0) return;
+  /* Swapped for an empty list first, so a failed allocation just waits for
+   * the next call */
+  if((retired = (co_obj_t *)co_list16_create()) == NULL) return;
+  DEBUG("Freeing %zd retired profiles.", co_list_length(_profiles_retired));
+  co_obj_free(_profiles_retired);
+  _profiles_retired = retired;
+}
+
 static co_obj_t *
 _co_profile_create(const char *name, const size_t nlen) 
 {
@@ -131,25 +496,46 @@ _co_profile_create(const char *name, const size_t nlen)
   profile->_header._type = _ext8;
   profile->_header._ref = 0;
   profile->_header._flags = 0;
-  profile->_len = (sizeof(co_obj_t *) * 2);
+  profile->_len = (sizeof(co_obj_t *) * 5) + sizeof(uint64_t);
   return (co_obj_t *)profile;
 error:
   DEBUG("Failed to create profile %s.", name);
   return NULL;
 }
 
+/* Index keys are the name bytes up to any terminating NUL, so names with
+ * and without one find the same profile. A name that is a prefix of an
+ * indexed one already has a node, left without a value, so it is forced. */
+static int
+_co_profile_index(co_obj_t *profile)
+{
+  char *name = NULL;
+  ssize_t nlen = co_obj_data(&name, ((co_profile_t *)profile)->name);
+  CHECK(nlen > 0 && (nlen = strnlen(name, nlen)) > 0, "Invalid profile name.");
+  _treenode_t *n = co_tree_find_node(co_tree_root(_profile_index), name, nlen);
+  CHECK(n == NULL || co_node_value(n) == NULL, "Profile %s already exists.", name);
+  CHECK(co_tree_insert_unsafe_force(_profile_index, name, nlen, profile), "Failed to index profile %s.", name);
+  if(!co_list_append(_profiles, profile))
+  {
+    co_tree_delete(_profile_index, name, nlen);
+    SENTINEL("Failed to add profile to list.");
+  }
+  return 1;
+error:
+  return 0;
+}
+
 int
 co_profile_remove(const char *name, const size_t nlen)
 {
-  co_obj_t *n = co_str8_create(name, nlen, 0);
-  co_obj_t *prof = co_profile_find(n);
+  co_obj_t *prof = co_profile_find_str(name, nlen);
+  CHECK(prof != NULL, "Failed to remove profile.");
+  co_tree_delete(_profile_index, name, strnlen(name, nlen));
   prof = co_list_delete(_profiles, prof);
   CHECK(prof != NULL, "Failed to remove profile.");
-
-  co_obj_free(n);
+  _co_profile_journal(PROFILE_CHANGE_REMOVE, name, nlen, NULL, 0);
   return 1;
 error:
-  co_obj_free(n);
   return 0;
 }
 
@@ -158,7 +544,8 @@ co_profile_add(const char *name, const size_t nlen)
 {
   co_obj_t *new_profile = _co_profile_create(name, nlen);
   CHECK(_co_schemas_load(new_profile, _schemas), "Failed to initialize profile with schema.");
-  CHECK(co_list_append(_profiles, new_profile), "Failed to add profile to list.");
+  CHECK(_co_profile_index(new_profile), "Failed to add profile.");
+  ((co_profile_t *)new_profile)->version = _co_profile_journal(PROFILE_CHANGE_ADD, name, nlen, NULL, 0);
 
   return 1;
 error:
@@ -172,13 +559,29 @@ co_profiles_init(const size_t index_size)
   if(index_size == 16)
   {
     CHECK((_profiles = (co_obj_t *)co_list16_create()) != NULL, "Profile list creation failed.");
+    CHECK((_profile_index = (co_obj_t *)co_tree16_create()) != NULL, "Profile index creation failed.");
   }
   else if(index_size == 32)
   {
     CHECK((_profiles = (co_obj_t *)co_list32_create()) != NULL, "Profile list creation failed.");
+    CHECK((_profile_index = (co_obj_t *)co_tree32_create()) != NULL, "Profile index creation failed.");
   }
   else SENTINEL("Invalid list index size.");
 
+  if(_profiles_retired == NULL)
+  {
+    CHECK((_profiles_retired = (co_obj_t *)co_list16_create()) != NULL, "Retired profile list creation failed.");
+  }
+
+  if(_templates_retired == NULL)
+  {
+    CHECK((_templates_retired = (co_obj_t *)co_list16_create()) != NULL, "Retired template list creation failed.");
+  }
+
+  /* Versions of each run start from its start time, so ones a client kept
+   * from an earlier run are too old for the journal */
+  if(_profile_version == 0) _profile_version = (uint64_t)time(NULL) << 32;
+
   if(_schemas == NULL)
   {
     CHECK((_schemas = (co_obj_t *)co_list16_create()) != NULL, "Schema list creation failed.");
@@ -200,75 +603,60 @@ error:
   return 0;
 }
 
-static jsmntok_t *_co_json_string_tokenize(const char *js)
-{
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  unsigned int t = DEFAULT_TOKENS;
-  jsmntok_t *tokens = h_calloc(t, sizeof(jsmntok_t));
-  CHECK_MEM(tokens);
-
-  int ret = jsmn_parse(&parser, js, tokens, t);
-
-  while (ret == JSMN_ERROR_NOMEM)
-  {
-      t = t * 2 + 1;
-      tokens = h_realloc(tokens, sizeof(jsmntok_t) * t);
-      CHECK_MEM(tokens);
-      ret = jsmn_parse(&parser, js, tokens, t);
-  }
-
-  CHECK(ret != JSMN_ERROR_INVAL, "Invalid JSON.");
-  CHECK(ret != JSMN_ERROR_PART, "Incomplete JSON.");
-
-  return tokens;
-error:
-  if(tokens != NULL) h_free(tokens);
-  return NULL;
-}
-
 static char *_co_json_token_stringify(char *json, const jsmntok_t *token)
 {
   json[token->end] = '\0';
   return json + token->start;
 }
 
-static int _co_profile_import_files_i(const char *path, const char *filename) {
+/* Maps the file at path and sets every string pair of its root object in
+ * profile. Tokens are counted in a first jsmn pass so the parse proper runs
+ * once over an exactly sized array. */
+static int
+_co_profile_import_file(co_obj_t *profile, const char *path)
+{
   int ret = 0;
-  char path_tmp[PATH_MAX] = {};
-  FILE *config_file = NULL;
+  int fd = -1;
+  char *buffer = MAP_FAILED;
+  size_t fsize = 0;
   jsmntok_t *tokens = NULL;
-  char *buffer = NULL;
-
-  DEBUG("Importing file %s at path %s", filename, path);
-
-  strlcpy(path_tmp, path, PATH_MAX);
-  strlcat(path_tmp, "/", PATH_MAX);
-  strlcat(path_tmp, filename, PATH_MAX);
-  config_file = fopen(path_tmp, "rb");
-  CHECK(config_file != NULL, "File %s/%s could not be opened", path, filename);
-  fseek(config_file, 0, SEEK_END);
-  long fsize = ftell(config_file);
-  rewind(config_file);
-  buffer = h_calloc(1, fsize + 1);
-  CHECK(fread(buffer, fsize, 1, config_file) != 0, "Failed to read from file.");
-  fclose(config_file);
-  config_file = NULL;
-  
-  buffer[fsize] = '\0';
-  tokens = _co_json_string_tokenize(buffer);
+  int ntokens = 0;
+  jsmn_parser parser;
+  struct stat st;
+
+  DEBUG("Importing file at path %s", path);
+
+  CHECK((fd = open(path, O_RDONLY)) >= 0, "File %s could not be opened", path);
+  CHECK(fstat(fd, &st) == 0, "Failed to stat %s.", path);
+  CHECK(st.st_size > 0, "File %s is empty.", path);
+  fsize = st.st_size;
+  /* Private and writable, since tokens are NUL-terminated in place */
+  buffer = mmap(NULL, fsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  CHECK(buffer != MAP_FAILED, "Failed to map %s.", path);
+  close(fd);
+  fd = -1;
+
+  jsmn_init(&parser);
+  ntokens = jsmn_parse(&parser, buffer, fsize, NULL, 0);
+  CHECK(ntokens != JSMN_ERROR_INVAL, "Invalid JSON.");
+  CHECK(ntokens != JSMN_ERROR_PART, "Incomplete JSON.");
+  CHECK(ntokens > 0, "No JSON in %s.", path);
+  tokens = h_calloc(ntokens, sizeof(jsmntok_t));
+  CHECK_MEM(tokens);
+  jsmn_init(&parser);
+  ntokens = jsmn_parse(&parser, buffer, fsize, tokens, ntokens);
+  CHECK(ntokens != JSMN_ERROR_INVAL, "Invalid JSON.");
+  CHECK(ntokens != JSMN_ERROR_PART, "Incomplete JSON.");
+  CHECK(ntokens > 0, "Failed to parse %s.", path);
 
   typedef enum { START, KEY, VALUE, STOP } parse_state;
   parse_state state = START;
 
   size_t object_tokens = 0;
-  co_obj_t *new_profile = _co_profile_create(filename, strlen(filename) + 1);
-  CHECK(_co_schemas_load(new_profile, _schemas), "Failed to initialize profile with schema.");
   char *key = NULL;
   size_t klen = 0;
 
-  for (size_t i = 0, j = 1; j > 0; i++, j--)
+  for (size_t i = 0, j = 1; j > 0 && i < (size_t)ntokens; i++, j--)
   {
     jsmntok_t *t = &tokens[i];
 
@@ -307,7 +695,7 @@ static int _co_profile_import_files_i(const char *path, const char *filename) {
 
         if(key != NULL && klen > 0)
         {
-          if(!co_profile_set_str(new_profile, key, klen + 1, _co_json_token_stringify(buffer, t), t->end - t->start + 1))
+          if(!co_profile_set_str(profile, key, klen + 1, _co_json_token_stringify(buffer, t), t->end - t->start + 1))
           {
             INFO("Value not in schema.");
           }
@@ -333,133 +721,539 @@ static int _co_profile_import_files_i(const char *path, const char *filename) {
     }
   }
 
-  co_list_append(_profiles, new_profile);
-
   ret = 1;
 
 error:
-  if(config_file != NULL) fclose(config_file);
-  if(!ret && new_profile != NULL) co_obj_free(new_profile);
-  if (tokens) h_free(tokens);
-  if (buffer) h_free(buffer);
+  if(fd >= 0) close(fd);
+  if(buffer != MAP_FAILED) munmap(buffer, fsize);
+  if(tokens != NULL) h_free(tokens);
   return ret;
 }
 
-int co_profile_import_files(const char *path) {
-  DEBUG("Importing files from %s", path);
-  CHECK(process_files(path, _co_profile_import_files_i), "Failed to load all profiles.");
+/* Builds the profile for one file, without registering it. Runs on the
+ * loader threads, so it touches nothing shared but the schema list. */
+static co_obj_t *
+_co_profile_load(const char *path, const char *filename)
+{
+  co_obj_t *new_profile = NULL;
 
-  return 1;
+  CHECK_MEM(new_profile = _co_profile_create(filename, strlen(filename) + 1));
+  CHECK(_co_schemas_load(new_profile, _schemas), "Failed to initialize profile with schema.");
+  CHECK(_co_profile_import_file(new_profile, path), "Failed to import profile %s.", filename);
+
+  return new_profile;
 
 error:
-  return 0;
+  if(new_profile != NULL) co_obj_free(new_profile);
+  return NULL;
 }
 
-int co_profile_import_global(const char *path) {
+/* Profile cache layout: header, then count entries sorted by name, then for
+ * each entry the NUL-terminated name followed by the co_tree_raw dump of the
+ * profile's data. Native byte order; it never leaves the machine. */
+typedef struct {
+  char magic[4];
+  uint32_t count;
+  unsigned char schema[16]; /* digest of the schema defaults profiles were built with */
+} _co_profile_cache_header_t;
+
+typedef struct {
+  int64_t mtime; /* of the source file, in ns */
+  uint64_t size;
+  uint32_t offset;
+  uint32_t nlen;
+  uint32_t dlen;
+  uint32_t reserved;
+} _co_profile_cache_entry_t;
+
+#define PROFILE_CACHE_MAGIC "CPC1"
+#define PROFILE_RAW_MAX (16*1024*1024)
+
+typedef struct {
+  const char *path;
+  struct dirent **entries;
+  co_obj_t **results;
+  struct stat *stats;
+  int count;
+  int next;
+  int misses;
+  const char *cache;
+  size_t cache_size;
+  const _co_profile_cache_entry_t *cached;
+  uint32_t ncached;
+  pthread_mutex_t lock;
+} _co_profile_loader_t;
+
+static int64_t
+_co_profile_mtime(const struct stat *st)
+{
+  return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/* Identity of the file a profile was last exported to */
+typedef struct {
+  uint64_t dev;
+  uint64_t ino;
+  int64_t mtime;
+  uint64_t size;
+} _co_profile_saved_t;
+
+/* Whether path is still the file profile was last exported to, untouched
+ * since; compared by identity rather than name, as one file has many */
+static int
+_co_profile_saved(const co_obj_t *profile, const char *path)
+{
+  const co_profile_t *p = (const co_profile_t *)profile;
+  _co_profile_saved_t saved;
+  char *data = NULL;
+  struct stat st;
+
+  if(p->saved == NULL || co_obj_data(&data, p->saved) != sizeof(saved)) return 0;
+  if(stat(path, &st) != 0) return 0;
+  memmove(&saved, data, sizeof(saved)); /* bin data isn't aligned */
+  return saved.dev == (uint64_t)st.st_dev && saved.ino == (uint64_t)st.st_ino &&
+    saved.mtime == _co_profile_mtime(&st) && saved.size == (uint64_t)st.st_size;
+}
+
+/* Digest of the schema template and enum choices. Cached profiles only hold
+ * values for keys their schemas had, checked against those choices, so a
+ * plugin that changes either invalidates the whole cache. */
+static int
+_co_profile_schema_digest(unsigned char *digest)
+{
   int ret = 0;
-  FILE *config_file = NULL;
-  jsmntok_t *tokens = NULL;
+  co_obj_t *trees[2] = { NULL, NULL };
+  char *buf = NULL;
+  size_t cap = 4096;
+  ssize_t len = 0;
+  MD5_CTX ctx;
+
+  CHECK((trees[0] = _co_schemas_template(_schemas)) != NULL, "Failed to compile schemas.");
+  trees[1] = _schema_choices; /* filled in by compiling the template */
+  CHECK_MEM(buf = h_malloc(cap));
+  MD5_Init(&ctx);
+  for(int i = 0; i < 2 && trees[i] != NULL; i++)
+  {
+    while((len = co_tree_raw(buf, cap, trees[i])) < 0)
+    {
+      CHECK(cap < PROFILE_RAW_MAX, "Schema too large.");
+      cap *= 2;
+      CHECK_MEM(buf = h_realloc(buf, cap));
+    }
+    MD5_Update(&ctx, buf, len);
+  }
+  MD5_Final(digest, &ctx);
+  ret = 1;
 
-  if(_profile_global == NULL)
+error:
+  if(buf != NULL) h_free(buf);
+  return ret;
+}
+
+/* Maps the cache at file, if it is intact and was built with the current
+ * schemas; otherwise profiles are simply all parsed from their files */
+static void
+_co_profile_cache_map(_co_profile_loader_t *loader, const char *file)
+{
+  int fd = -1;
+  char *map = MAP_FAILED;
+  struct stat st;
+  const _co_profile_cache_header_t *header = NULL;
+  const _co_profile_cache_entry_t *cached = NULL;
+  unsigned char digest[16];
+
+  if((fd = open(file, O_RDONLY)) < 0)
+  {
+    DEBUG("No profile cache at %s.", file);
+    return;
+  }
+  CHECK(fstat(fd, &st) == 0, "Failed to stat %s.", file);
+  CHECK((size_t)st.st_size >= sizeof(_co_profile_cache_header_t), "Profile cache %s truncated.", file);
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  CHECK(map != MAP_FAILED, "Failed to map %s.", file);
+
+  header = (const _co_profile_cache_header_t *)map;
+  cached = (const _co_profile_cache_entry_t *)(map + sizeof(_co_profile_cache_header_t));
+  CHECK(!memcmp(header->magic, PROFILE_CACHE_MAGIC, sizeof(header->magic)), "Not a profile cache: %s.", file);
+  CHECK(header->count <= (st.st_size - sizeof(_co_profile_cache_header_t)) / sizeof(_co_profile_cache_entry_t), "Profile cache %s truncated.", file);
+  for(uint32_t i = 0; i < header->count; i++)
   {
-    _profile_global = _co_profile_create("global", sizeof("global"));
+    CHECK(cached[i].nlen > 0 && cached[i].dlen > 0 &&
+        (uint64_t)cached[i].offset + cached[i].nlen + cached[i].dlen <= (uint64_t)st.st_size &&
+        map[cached[i].offset + cached[i].nlen - 1] == '\0', "Profile cache %s corrupt.", file);
+  }
+  CHECK(_co_profile_schema_digest(digest), "Failed to digest schemas.");
+  if(memcmp(digest, header->schema, sizeof(digest)))
+  {
+    INFO("Profile schemas changed, ignoring cache %s.", file);
+    goto error;
   }
-  _co_schemas_load(_profile_global, _schemas_global);
 
-  DEBUG("Importing file at path %s", path);
+  close(fd);
+  loader->cache = map;
+  loader->cache_size = st.st_size;
+  loader->cached = cached;
+  loader->ncached = header->count;
+  return;
 
-  config_file = fopen(path, "rb");
-  CHECK(config_file != NULL, "File %s could not be opened", path);
-  fseek(config_file, 0, SEEK_END);
-  long fsize = ftell(config_file);
-  rewind(config_file);
-  char *buffer = h_calloc(1, fsize + 1);
-  CHECK(fread(buffer, fsize, 1, config_file) != 0, "Failed to read from file.");
-  fclose(config_file);
-  config_file = NULL;
-  
-  buffer[fsize] = '\0';
-  tokens = _co_json_string_tokenize(buffer);
+error:
+  if(map != MAP_FAILED) munmap(map, st.st_size);
+  if(fd >= 0) close(fd);
+}
 
-  typedef enum { START, KEY, VALUE, STOP } parse_state;
-  parse_state state = START;
+static int
+_co_profile_cache_cmp(const void *key, const void *member)
+{
+  const _co_profile_loader_t *loader = ((const void **)key)[0];
+  const char *name = ((const void **)key)[1];
+  return strcmp(name, loader->cache + ((const _co_profile_cache_entry_t *)member)->offset);
+}
 
-  size_t object_tokens = 0;
-  char *key = NULL;
-  size_t klen = 0;
+/* Rebuilds the profile for entry i from the cache if its file is unchanged */
+static co_obj_t *
+_co_profile_load_cached(_co_profile_loader_t *loader, int i, const char *path)
+{
+  const char *name = loader->entries[i]->d_name;
+  const void *key[2] = { loader, name };
+  const _co_profile_cache_entry_t *entry = NULL;
+  co_obj_t *profile = NULL, *data = NULL;
+
+  if(loader->ncached == 0) return NULL;
+  entry = bsearch(key, loader->cached, loader->ncached, sizeof(_co_profile_cache_entry_t), _co_profile_cache_cmp);
+  if(entry == NULL || entry->mtime != _co_profile_mtime(&loader->stats[i]) ||
+      entry->size != (uint64_t)loader->stats[i].st_size) return NULL;
+
+  CHECK_MEM(profile = _co_profile_create(name, strlen(name) + 1));
+  CHECK(_co_schemas_load(profile, _schemas), "Failed to initialize profile with schema.");
+  CHECK(co_tree_import(&data, loader->cache + entry->offset + entry->nlen, entry->dlen) > 0, "Failed to import cached profile %s.", name);
+  co_obj_free(((co_profile_t *)profile)->data);
+  ((co_profile_t *)profile)->data = data;
+  hattach(data, profile);
+  return profile;
 
-  for (size_t i = 0, j = 1; j > 0; i++, j--)
-  {
-    jsmntok_t *t = &tokens[i];
+error:
+  if(profile != NULL) co_obj_free(profile);
+  return NULL;
+}
 
-    // Should never reach uninitialized tokens
-    CHECK(t->start != -1 && t->end != -1, "Tokens uninitialized.");
+static void *
+_co_profile_loader(void *arg)
+{
+  _co_profile_loader_t *loader = arg;
+  char path[PATH_MAX];
+  for(;;)
+  {
+    pthread_mutex_lock(&loader->lock);
+    int i = loader->next++;
+    pthread_mutex_unlock(&loader->lock);
+    if(i >= loader->count) break;
+
+    const char *name = loader->entries[i]->d_name;
+    if(snprintf(path, PATH_MAX, "%s/%s", loader->path, name) >= PATH_MAX ||
+        stat(path, &loader->stats[i]) != 0)
+    {
+      WARN("Failed to stat profile %s.", path);
+      continue;
+    }
+    if((loader->results[i] = _co_profile_load_cached(loader, i, path)) != NULL) continue;
 
-    if (t->type == JSMN_ARRAY || t->type == JSMN_OBJECT)
-      j += t->size;
+    pthread_mutex_lock(&loader->lock);
+    loader->misses++;
+    pthread_mutex_unlock(&loader->lock);
+    loader->results[i] = _co_profile_load(path, name);
+  }
+  return NULL;
+}
 
-    switch (state)
+/* Writes every profile this import registered to file, replacing it
+ * atomically */
+static int
+_co_profile_cache_write(_co_profile_loader_t *loader, const char *file)
+{
+  int ret = 0;
+  char tmp[PATH_MAX];
+  FILE *out = NULL;
+  char *buf = NULL;
+  size_t cap = 16384;
+  _co_profile_cache_header_t header = { .magic = PROFILE_CACHE_MAGIC };
+  _co_profile_cache_entry_t *cached = NULL;
+  uint32_t offset = 0;
+
+  for(int i = 0; i < loader->count; i++)
+    if(loader->results[i] != NULL) header.count++;
+  CHECK(_co_profile_schema_digest(header.schema), "Failed to digest schemas.");
+  if(header.count > 0)
+    CHECK_MEM(cached = h_calloc(header.count, sizeof(_co_profile_cache_entry_t)));
+  CHECK_MEM(buf = h_malloc(cap));
+
+  CHECK(snprintf(tmp, sizeof(tmp), "%s.tmp", file) < (int)sizeof(tmp), "Cache path too long.");
+  CHECK((out = fopen(tmp, "wb")) != NULL, "Failed to open %s.", tmp);
+  offset = sizeof(header) + header.count * sizeof(_co_profile_cache_entry_t);
+  CHECK(fseek(out, offset, SEEK_SET) == 0, "Failed to write %s.", tmp);
+
+  for(int i = 0, n = 0; i < loader->count; i++)
+  {
+    if(loader->results[i] == NULL) continue;
+    const char *name = loader->entries[i]->d_name;
+    ssize_t dlen = 0;
+    while((dlen = co_tree_raw(buf, cap, ((co_profile_t *)loader->results[i])->data)) < 0)
     {
-      case START:
-        CHECK(t->type == JSMN_OBJECT, "Invalid root element.");
+      CHECK(cap < PROFILE_RAW_MAX, "Profile %s too large to cache.", name);
+      cap *= 2;
+      CHECK_MEM(buf = h_realloc(buf, cap));
+    }
+    cached[n].mtime = _co_profile_mtime(&loader->stats[i]);
+    cached[n].size = loader->stats[i].st_size;
+    cached[n].offset = offset;
+    cached[n].nlen = strlen(name) + 1;
+    cached[n].dlen = dlen;
+    CHECK(fwrite(name, cached[n].nlen, 1, out) == 1 && fwrite(buf, dlen, 1, out) == 1, "Failed to write %s.", tmp);
+    offset += cached[n].nlen + dlen;
+    n++;
+  }
 
-        state = KEY;
-        object_tokens = t->size;
+  rewind(out);
+  CHECK(fwrite(&header, sizeof(header), 1, out) == 1, "Failed to write %s.", tmp);
+  if(header.count > 0)
+    CHECK(fwrite(cached, sizeof(_co_profile_cache_entry_t), header.count, out) == header.count, "Failed to write %s.", tmp);
+  CHECK(fclose(out) == 0, "Failed to write %s.", tmp);
+  out = NULL;
+  CHECK(rename(tmp, file) == 0, "Failed to replace %s.", file);
+  DEBUG("Cached %u profiles in %s.", header.count, file);
+  ret = 1;
 
-        if (object_tokens == 0)
-          state = STOP;
+error:
+  if(out != NULL)
+  {
+    fclose(out);
+    unlink(tmp);
+  }
+  if(cached != NULL) h_free(cached);
+  if(buf != NULL) h_free(buf);
+  return ret;
+}
 
-        CHECK(object_tokens % 2 == 0, "Object must have even number of children.");
-        break;
+/* Skips dotfiles, which include the temporary files of interrupted saves */
+static int
+_co_profile_filter(const struct dirent *entry)
+{
+  return entry->d_name[0] != '.';
+}
 
-      case KEY:
-        object_tokens--;
+/* Byte order rather than alphasort's collation, so the cache index can be
+ * searched with strcmp */
+static int
+_co_profile_sort(const struct dirent **a, const struct dirent **b)
+{
+  return strcmp((*a)->d_name, (*b)->d_name);
+}
 
-        CHECK(t->type == JSMN_STRING, "Keys must be strings.");
-        state = VALUE;
-        key = _co_json_token_stringify(buffer, t);
-        klen = t->end - t->start;
+int co_profile_import_files(const char *path) {
+  return co_profile_import_files_cached(path, NULL);
+}
 
-        break;
+int co_profile_import_files_cached(const char *path, const char *cache) {
+  int ret = 0;
+  _co_profile_loader_t loader = { .path = path };
+  pthread_t threads[PROFILE_LOAD_THREADS - 1];
+  int nthreads = 0;
 
-      case VALUE:
-        CHECK(t->type == JSMN_STRING, "Values must be strings.");
+  DEBUG("Importing files from %s", path);
+  pthread_mutex_init(&loader.lock, NULL);
+  loader.count = scandir(path, &loader.entries, _co_profile_filter, _co_profile_sort);
+  CHECK(loader.count >= 0, "Could not read directory %s.", path);
+  if(loader.count > 0)
+  {
+    CHECK_MEM(loader.results = h_calloc(loader.count, sizeof(co_obj_t *)));
+    CHECK_MEM(loader.stats = h_calloc(loader.count, sizeof(struct stat)));
+  }
+  /* Compiled here, as the loader threads may not race to do it */
+  CHECK(_co_schemas_template(_schemas) != NULL, "Failed to compile schemas.");
+  if(cache != NULL) _co_profile_cache_map(&loader, cache);
+
+  /* The calling thread loads too, so a failed spawn only costs parallelism */
+  for(; nthreads < PROFILE_LOAD_THREADS - 1 && nthreads < loader.count - 1; nthreads++)
+    if(pthread_create(&threads[nthreads], NULL, _co_profile_loader, &loader)) break;
+  _co_profile_loader(&loader);
+  for(int i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  DEBUG("Loaded %d profiles, %d parsed from source.", loader.count, loader.misses);
+
+  /* Register in name order, independent of which thread finished first */
+  for(int i = 0; i < loader.count; i++)
+  {
+    if(loader.results[i] == NULL)
+    {
+      WARN("Skipped profile %s.", loader.entries[i]->d_name);
+    }
+    else if(!_co_profile_index(loader.results[i]))
+    {
+      co_obj_free(loader.results[i]);
+      loader.results[i] = NULL;
+    }
+  }
 
-        if(key != NULL && klen > 0)
-        {
-          if(!co_profile_set_str(_profile_global, key, klen + 1, _co_json_token_stringify(buffer, t), t->end - t->start + 1))
-          {
-            INFO("Value not in schema.");
-          }
-          
-        }
+  if(cache != NULL && (loader.misses > 0 || (uint32_t)loader.count != loader.ncached))
+    if(!_co_profile_cache_write(&loader, cache)) WARN("Failed to write profile cache %s.", cache);
+  ret = 1;
 
-        key = NULL;
-        klen = 0;
-        object_tokens--;
-        state = KEY;
+error:
+  if(loader.cache != NULL) munmap((void *)loader.cache, loader.cache_size);
+  if(loader.entries != NULL)
+  {
+    for(int i = 0; i < loader.count; i++)
+      free(loader.entries[i]);
+    free(loader.entries);
+  }
+  if(loader.results != NULL) h_free(loader.results);
+  if(loader.stats != NULL) h_free(loader.stats);
+  pthread_mutex_destroy(&loader.lock);
+  return ret;
+}
 
-        if (object_tokens == 0)
-          state = STOP;
+int co_profile_import_global(const char *path) {
+  co_obj_t *new_profile = NULL;
+
+  /* Built aside and swapped in, so loading the file isn't journaled as
+   * changes to the global profile */
+  CHECK_MEM(new_profile = _co_profile_create("global", sizeof("global")));
+  CHECK(_co_schemas_load(new_profile, _schemas_global), "Failed to initialize profile with schema.");
+  CHECK(_co_profile_import_file(new_profile, path), "Failed to import %s.", path);
+  if(_profile_global != NULL) co_list_append(_profiles_retired, _profile_global);
+  _profile_global = new_profile;
+  return 1;
 
-        break;
+error:
+  if(new_profile != NULL) co_obj_free(new_profile);
+  return 0;
+}
 
-      case STOP:
-        // Just consume the tokens
-        break;
+int
+co_profile_hook(co_profile_hook_t cb, void *context)
+{
+  CHECK(_profile_nhooks < PROFILE_HOOKS_MAX, "Too many profile hooks.");
+  _profile_hooks[_profile_nhooks].cb = cb;
+  _profile_hooks[_profile_nhooks].context = context;
+  _profile_nhooks++;
+  return 1;
+error:
+  return 0;
+}
 
-      default:
-        SENTINEL("Invalid state %u", state);
-    }
+uint64_t
+co_profiles_version(void)
+{
+  return _profile_version;
+}
+
+uint64_t
+co_profile_version(co_obj_t *profile)
+{
+  CHECK(IS_PROFILE(profile), "Not a profile.");
+  return ((co_profile_t *)profile)->version;
+error:
+  return 0;
+}
+
+int
+co_profiles_changes(const uint64_t since, co_profile_change_t cb, void *context)
+{
+  char *name = NULL, *key = NULL;
+  /* A version ahead of ours was handed out by an earlier run */
+  if(since > _profile_version || _profile_version - since > PROFILE_JOURNAL_MAX) return 0;
+  for(uint64_t v = since + 1; v <= _profile_version; v++)
+  {
+    int i = v % PROFILE_JOURNAL_MAX;
+    name = key = NULL;
+    if(_profile_journal[i].name != NULL) co_obj_data(&name, _profile_journal[i].name);
+    if(_profile_journal[i].key != NULL) co_obj_data(&key, _profile_journal[i].key);
+    cb(v, _profile_journal[i].change, name, key, context);
   }
+  return 1;
+}
 
-  ret = 1;
+static void
+_co_profile_notify(const char *name, co_obj_t *profile)
+{
+  for(int i = 0; i < _profile_nhooks; i++)
+    _profile_hooks[i].cb(name, profile, _profile_hooks[i].context);
+}
+
+int
+co_profile_reload(const char *path, const char *filename)
+{
+  char file[PATH_MAX];
+  struct stat st;
+  size_t nlen = strlen(filename);
+  co_obj_t *old = NULL, *new_profile = NULL;
+
+  CHECK(nlen > 0 && snprintf(file, sizeof(file), "%s/%s", path, filename) < (int)sizeof(file), "Invalid profile %s.", filename);
+  old = co_tree_find(_profile_index, filename, nlen);
+  if(old != NULL && _co_profile_saved(old, file))
+  {
+    DEBUG("Profile %s is as it was last saved.", filename);
+    return 1;
+  }
+  if(stat(file, &st) != 0 && errno == ENOENT)
+  {
+    if(old == NULL) return 1;
+    INFO("Profile %s removed.", filename);
+  }
+  else
+  {
+    CHECK((new_profile = _co_profile_load(file, filename)) != NULL, "Failed to reload profile %s, keeping the loaded one.", filename);
+    INFO("Profile %s reloaded.", filename);
+  }
+
+  /* The new profile is fully built before the old one leaves the registry */
+  if(old != NULL)
+  {
+    co_tree_delete(_profile_index, filename, nlen);
+    co_list_delete(_profiles, old);
+    co_list_append(_profiles_retired, old);
+  }
+  if(new_profile != NULL && !_co_profile_index(new_profile))
+  {
+    co_obj_free(new_profile);
+    if(old != NULL) _co_profile_journal(PROFILE_CHANGE_REMOVE, filename, nlen, NULL, 0);
+    SENTINEL("Failed to add profile %s.", filename);
+  }
+  if(new_profile == NULL)
+    _co_profile_journal(PROFILE_CHANGE_REMOVE, filename, nlen, NULL, 0);
+  else
+    ((co_profile_t *)new_profile)->version = _co_profile_journal(old == NULL ? PROFILE_CHANGE_ADD : PROFILE_CHANGE_RELOAD, filename, nlen, NULL, 0);
+  _co_profile_notify(filename, new_profile);
+  return 1;
 
 error:
-  if(config_file != NULL) fclose(config_file);
-  if (buffer) h_free(buffer);
-  if (tokens) h_free(tokens);
-  return ret;
+  return 0;
+}
+
+int
+co_profile_reload_global(const char *path)
+{
+  co_obj_t *new_profile = NULL;
+
+  if(_profile_global != NULL && _co_profile_saved(_profile_global, path))
+  {
+    DEBUG("Global configuration %s is as it was last saved.", path);
+    return 1;
+  }
+  CHECK_MEM(new_profile = _co_profile_create("global", sizeof("global")));
+  CHECK(_co_schemas_load(new_profile, _schemas_global), "Failed to initialize profile with schema.");
+  CHECK(_co_profile_import_file(new_profile, path), "Failed to reload %s, keeping the loaded one.", path);
+  INFO("Global configuration %s reloaded.", path);
+
+  /* Startup settings may still point into the old global profile */
+  if(_profile_global != NULL) co_list_append(_profiles_retired, _profile_global);
+  _profile_global = new_profile;
+  ((co_profile_t *)new_profile)->version = _co_profile_journal(PROFILE_CHANGE_RELOAD, "global", sizeof("global"), NULL, 0);
+  _co_profile_notify("global", new_profile);
+  return 1;
+
+error:
+  if(new_profile != NULL) co_obj_free(new_profile);
+  return 0;
 }
 
 co_obj_t *
@@ -472,23 +1266,86 @@ co_profile_get(co_obj_t *profile, const co_obj_t *key)
   ssize_t klen = co_obj_data(&kstr, key);
   CHECK(klen > 0, "Invalid profile name");
   co_obj_t *obj = NULL;
-  CHECK((obj = co_tree_find(((co_profile_t*)profile)->data, kstr, klen)) != NULL, "Failed to find key %s.", kstr);
+  CHECK((obj = _co_profile_lookup(profile, kstr, klen)) != NULL, "Failed to find key %s.", kstr);
   return obj;
 
 error:
   return NULL;
 }
 
+int
+co_profile_insert_value(co_obj_t *tree, co_obj_t *profile, const char *key, const size_t klen)
+{
+  co_obj_t *value = NULL, *text = NULL;
+  char buf[PROFILE_TEXT_MAX];
+  ssize_t len = 0;
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  CHECK((value = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
+  if(IS_STR(value)) return co_tree_insert_unsafe(tree, key, klen, value);
+  CHECK((len = _co_profile_format(value, _co_profile_type(profile, key, klen), buf, sizeof(buf))) > 0, "Failed to format %s.", key);
+  CHECK_MEM(text = co_str8_create(buf, len, 0));
+  CHECK(co_tree_insert(tree, key, klen, text), "Failed to insert %s.", key);
+  return 1;
+error:
+  if(text != NULL) co_obj_free(text);
+  return 0;
+}
+
+int
+co_profile_check_str(co_obj_t *profile, const char *key, const size_t klen, const char *value, const size_t vlen)
+{
+  co_obj_t *obj = NULL;
+  int type = -1;
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  CHECK((type = _co_profile_type(profile, key, klen)) >= 0, "No corresponding key %s in schema.", key);
+  CHECK(type != PROFILE_ENUM || _co_profile_choice(key, klen, value, vlen), "Value %s is not a choice for %s.", value, key);
+  if(type == PROFILE_STR || type == PROFILE_ENUM)
+  {
+    CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL && IS_STR(obj), "Key %s is not a string.", key);
+    CHECK(CO_TYPE(obj) != _str8 || vlen <= UINT8_MAX, "Value too large for key %s.", key);
+    CHECK(CO_TYPE(obj) != _str16 || vlen <= UINT16_MAX, "Value too large for key %s.", key);
+    return 1;
+  }
+  CHECK((obj = _co_profile_parse(type, key, value, vlen)) != NULL, "Invalid value %s for %s.", value, key);
+  co_obj_free(obj);
+  return 1;
+error:
+  return 0;
+}
+
+/* Strings are set in place; typed values are parsed here, once, so readers
+ * get them natively */
 int 
 co_profile_set_str(co_obj_t *profile, const char *key, const size_t klen, const char *value, const size_t vlen) 
 {
+    co_obj_t *data = NULL, *obj = NULL;
+    int type = -1;
     CHECK(IS_PROFILE(profile),"Not a profile.");
-    CHECK(co_tree_set_str(((co_profile_t*)profile)->data, key, klen, value, vlen), 
+    CHECK((type = _co_profile_type(profile, key, klen)) >= 0,
             "No corresponding key %s in schema, can't set %s:%s",
             key, key, value);
+    CHECK(type != PROFILE_ENUM || _co_profile_choice(key, klen, value, vlen),
+            "Value %s is not a choice for %s.", value, key);
+    if(type == PROFILE_STR || type == PROFILE_ENUM)
+    {
+      CHECK((data = _co_profile_own(profile, key, klen)) != NULL &&
+          co_tree_set_str(data, key, klen, value, vlen), 
+              "Can't set %s:%s", key, value);
+      _co_profile_changed(profile, key, klen);
+      return 1;
+    }
+    data = ((co_profile_t *)profile)->data;
+    CHECK((obj = _co_profile_parse(type, key, value, vlen)) != NULL, "Can't set %s:%s", key, value);
+    _treenode_t *n = co_tree_find_node(co_tree_root(data), key, klen);
+    if(n != NULL && co_node_value(n) != NULL)
+      co_obj_free(co_tree_delete(data, key, klen));
+    /* Forced, since the key's node may outlive its value as a prefix of others */
+    CHECK(co_tree_insert_force(data, key, klen, obj), "Can't set %s:%s", key, value);
+    _co_profile_changed(profile, key, klen);
     return 1;
 
 error:
+    if(obj != NULL) co_obj_free(obj);
     return 0;
 }
 
@@ -499,7 +1356,7 @@ co_profile_get_str(co_obj_t *profile, char **output, const char *key, const size
   CHECK_MEM(((co_profile_t*)profile)->data);
   CHECK_MEM(key);
   co_obj_t *obj = NULL;
-  CHECK((obj = co_tree_find(((co_profile_t*)profile)->data, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
   CHECK(IS_STR(obj), "Object is not a string.");
   return co_obj_data((char **)output, obj);
 
@@ -510,10 +1367,13 @@ error:
 int 
 co_profile_set_int(co_obj_t *profile, const char *key, const size_t klen, const signed long value) 
 {
+  co_obj_t *data = NULL;
   CHECK(IS_PROFILE(profile),"Not a profile.");
-  CHECK(co_tree_set_int(((co_profile_t*)profile)->data, key, klen, value), 
+  CHECK((data = _co_profile_own(profile, key, klen)) != NULL &&
+      co_tree_set_int(data, key, klen, value), 
             "No corresponding key %s in schema, can't set %s:%ld",
             key, key, value);
+    _co_profile_changed(profile, key, klen);
     return 1;
 
 error:
@@ -527,7 +1387,7 @@ co_profile_get_int(co_obj_t *profile, const char *key, const size_t klen)
   CHECK_MEM(((co_profile_t*)profile)->data);
   CHECK_MEM(key);
   co_obj_t *obj = NULL;
-  CHECK((obj = co_tree_find(((co_profile_t*)profile)->data, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
   CHECK(IS_INT(obj), "Object is not a signed integer.");
   signed long *output;
   CHECK(co_obj_data((char **)&output, obj) >= 0, "Failed to read data from %s.", key);
@@ -540,10 +1400,13 @@ error:
 int 
 co_profile_set_uint(co_obj_t *profile, const char *key, const size_t klen, const unsigned long value) 
 {
+    co_obj_t *data = NULL;
     CHECK(IS_PROFILE(profile),"Not a profile.");
-    CHECK(co_tree_set_uint(((co_profile_t*)profile)->data, key, klen, value), 
+    CHECK((data = _co_profile_own(profile, key, klen)) != NULL &&
+        co_tree_set_uint(data, key, klen, value), 
             "No corresponding key %s in schema, can't set %s:%lu",
             key, key, value);
+    _co_profile_changed(profile, key, klen);
     return 1;
 
 error:
@@ -557,11 +1420,63 @@ co_profile_get_uint(co_obj_t *profile, const char *key, const size_t klen)
   CHECK_MEM(((co_profile_t*)profile)->data);
   CHECK_MEM(key);
   co_obj_t *obj = NULL;
-  CHECK((obj = co_tree_find(((co_profile_t*)profile)->data, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
   CHECK(IS_UINT(obj), "Object is not an unsigned integer.");
-  unsigned long *output;
-  CHECK(co_obj_data((char **)&output, obj) >= 0, "Failed to read data from %s.", key);
-  return *output;
+  return _co_profile_uint(obj);
+
+error:
+  return -1;
+}
+
+int
+co_profile_get_bool(co_obj_t *profile, const char *key, const size_t klen)
+{
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  co_obj_t *obj = NULL;
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK(IS_BOOL(obj), "Object is not a boolean.");
+  return IS_TRUE(obj);
+
+error:
+  return -1;
+}
+
+int
+co_profile_get_ipv4(co_obj_t *profile, const char *key, const size_t klen, struct in_addr *output)
+{
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  co_obj_t *obj = NULL;
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK(_co_profile_type(profile, key, klen) == PROFILE_IPV4 && IS_UINT(obj), "Object is not an address.");
+  output->s_addr = _co_profile_uint(obj);
+  return 1;
+
+error:
+  return 0;
+}
+
+int
+co_profile_get_mac(co_obj_t *profile, const char *key, const size_t klen, unsigned char *output)
+{
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  co_obj_t *obj = NULL;
+  char *data = NULL;
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK(IS_BIN(obj) && co_obj_data(&data, obj) == PROFILE_MAC_SIZE, "Object is not a MAC address.");
+  memmove(output, data, PROFILE_MAC_SIZE);
+  return 1;
+
+error:
+  return 0;
+}
+
+ssize_t
+co_profile_get_text(co_obj_t *profile, const char *key, const size_t klen, char *output, const size_t size)
+{
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  co_obj_t *obj = NULL;
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
+  return _co_profile_format(obj, _co_profile_type(profile, key, klen), output, size);
 
 error:
   return -1;
@@ -570,10 +1485,13 @@ error:
 int 
 co_profile_set_float(co_obj_t *profile, const char *key, const size_t klen, const double value) 
 {
+    co_obj_t *data = NULL;
     CHECK(IS_PROFILE(profile),"Not a profile.");
-    CHECK(co_tree_set_float(((co_profile_t*)profile)->data, key, klen, value), 
+    CHECK((data = _co_profile_own(profile, key, klen)) != NULL &&
+        co_tree_set_float(data, key, klen, value), 
             "No corresponding key %s in schema, can't set %s:%lf",
             key, key, value);
+    _co_profile_changed(profile, key, klen);
     return 1;
 
 error:
@@ -587,7 +1505,7 @@ co_profile_get_float(co_obj_t *profile, const char *key, const size_t klen)
   CHECK_MEM(((co_profile_t*)profile)->data);
   CHECK_MEM(key);
   co_obj_t *obj = NULL;
-  CHECK((obj = co_tree_find(((co_profile_t*)profile)->data, key, klen)) != NULL, "Failed to find key %s.", key);
+  CHECK((obj = _co_profile_lookup(profile, key, klen)) != NULL, "Failed to find key %s.", key);
   CHECK(IS_FLOAT(obj), "Object is not a floating point value.");
   double *output;
   CHECK(co_obj_data((char **)&output, obj) >= 0, "Failed to read data from %s.", key);
@@ -613,11 +1531,14 @@ char *co_list_profiles(void) {
 }
 */
 
-static co_obj_t *
-_co_profile_find_i(co_obj_t *list, co_obj_t *current, void *context) 
+co_obj_t *
+co_profile_find_str(const char *name, const size_t nlen) 
 {
-  if (IS_PROFILE(current))
-    if(!co_str_cmp(((co_profile_t *)current)->name, context)) return current;
+  CHECK(name != NULL && nlen > 0, "Not a valid search index.");
+  co_obj_t *result = NULL;
+  CHECK((result = co_tree_find(_profile_index, name, strnlen(name, nlen))) != NULL, "Failed to find profile.");
+  return result;
+error:
   return NULL;
 }
 
@@ -625,9 +1546,9 @@ co_obj_t *
 co_profile_find(co_obj_t *name) 
 {
   CHECK(IS_STR(name), "Not a valid search index.");
-  co_obj_t *result = NULL;
-  CHECK((result = co_list_parse(_profiles, _co_profile_find_i, name)) != NULL, "Failed to find profile.");
-  return result;
+  char *nstr = NULL;
+  ssize_t nlen = co_obj_data(&nstr, name);
+  return co_profile_find_str(nstr, nlen);
 error:
   return NULL;
 }
@@ -645,53 +1566,193 @@ co_profile_global(void)
   return _profile_global;
 }
 
-static inline void
-_co_profile_export_file_r(co_obj_t *tree, _treenode_t *current, int *count, FILE *config_file)
+static void
+_co_profile_values_r(co_obj_t *values, co_obj_t *profile, _treenode_t *current)
 {
   if(current == NULL) return;
-  CHECK(IS_TREE(tree), "Recursion target is not a tree.");
-  char *key = NULL;
-  char *value = NULL;
   if(co_node_value(current) != NULL)
   {
-    (*count)++;
+    char *key = NULL;
+    ssize_t klen = co_obj_data(&key, co_node_key(current));
+    _treenode_t *n = co_tree_find_node(co_tree_root(values), key, klen);
+    if(n == NULL || co_node_value(n) == NULL)
+      co_profile_insert_value(values, profile, key, klen);
+  }
+  _co_profile_values_r(values, profile, current->low);
+  _co_profile_values_r(values, profile, current->equal);
+  _co_profile_values_r(values, profile, current->high);
+}
+
+co_obj_t *
+co_profile_values(co_obj_t *profile)
+{
+  co_obj_t *values = NULL;
+  CHECK(IS_PROFILE(profile), "Not a profile.");
+  CHECK_MEM(values = co_tree16_create());
+  _co_profile_values_r(values, profile, co_tree_root(((co_profile_t *)profile)->data));
+  if(((co_profile_t *)profile)->defaults != NULL)
+    _co_profile_values_r(values, profile, co_tree_root(((co_profile_t *)profile)->defaults));
+  return values;
+error:
+  return NULL;
+}
+
+co_obj_t *
+co_profile_get_derived(co_obj_t *profile, const char *key, const size_t klen)
+{
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  co_obj_t *derived = ((co_profile_t *)profile)->derived;
+  if(derived == NULL) return NULL;
+  _treenode_t *n = co_tree_find_node(co_tree_root(derived), key, klen);
+  return n != NULL ? co_node_value(n) : NULL;
+error:
+  return NULL;
+}
+
+int
+co_profile_set_derived(co_obj_t *profile, const char *key, const size_t klen, co_obj_t *value)
+{
+  co_profile_t *p = (co_profile_t *)profile;
+  CHECK_MEM(value);
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  if(p->derived == NULL)
+  {
+    CHECK_MEM(p->derived = co_tree16_create());
+    hattach(p->derived, p);
+  }
+  CHECK(co_tree_insert_force(p->derived, key, klen, value), "Failed to store %s.", key);
+  return 1;
+error:
+  if(value != NULL) co_obj_free(value);
+  return 0;
+}
+
+static co_obj_t *
+_co_profiles_clear_derived_i(co_obj_t *list, co_obj_t *current, void *context)
+{
+  if(IS_PROFILE(current)) _co_profile_clear_derived(current);
+  return NULL;
+}
+
+void
+co_profiles_clear_derived(void)
+{
+  if(_profiles != NULL) co_list_parse(_profiles, _co_profiles_clear_derived_i, NULL);
+  if(_profile_global != NULL) _co_profile_clear_derived(_profile_global);
+}
+
+/* Appends a "key": "value" line per value to the export buffer, growing it
+ * as needed; the buffer starts out holding just the opening brace */
+static int
+_co_profile_export_r(_treenode_t *current, char **buf, size_t *cap, size_t *len)
+{
+  if(current == NULL) return 1;
+  if(co_node_value(current) != NULL)
+  {
+    char *key = NULL, *value = NULL;
+    int n = 0;
     co_obj_data(&key, co_node_key(current));
     co_obj_data(&value, co_node_value(current));
-    //CHECK(IS_STR(key) && IS_STR(value), "Incorrect types for profile.");
-    if(*count < co_tree_length(tree))
+    while((n = snprintf(*buf + *len, *cap - *len, "%s  \"%s\": \"%s\"",
+            *len > sizeof("{\n") - 1 ? ",\n" : "", key, value)) >= (int)(*cap - *len))
     {
-      fprintf(config_file, "  \"%s\": \"%s\",\n", key, value);
-    }
-    else
-    {
-      fprintf(config_file, "  \"%s\": \"%s\"\n", key, value);
+      CHECK(*cap < PROFILE_RAW_MAX, "Profile too large to export.");
+      *cap *= 2;
+      CHECK_MEM(*buf = h_realloc(*buf, *cap));
     }
+    CHECK(n >= 0, "Failed to format %s.", key);
+    *len += n;
   }
-  _co_profile_export_file_r(tree, current->low, count, config_file); 
-  _co_profile_export_file_r(tree, current->equal, count, config_file); 
-  _co_profile_export_file_r(tree, current->high, count, config_file); 
-  return; 
+  return _co_profile_export_r(current->low, buf, cap, len) &&
+    _co_profile_export_r(current->equal, buf, cap, len) &&
+    _co_profile_export_r(current->high, buf, cap, len);
 error:
-  return;
+  return 0;
 }
 
 int 
 co_profile_export_file(co_obj_t *profile, const char *path)
 {
-  CHECK(IS_PROFILE(profile),"Not a profile.");
-  int count = 0;
-  FILE *config_file = fopen(path, "wb");
-  CHECK(config_file != NULL, "Config file %s could not be opened", path);
+  int ret = 0;
+  int fd = -1;
+  co_obj_t *values = NULL;
+  co_profile_t *p = (co_profile_t *)profile;
+  char tmp[PATH_MAX] = "";
+  _co_profile_saved_t saved;
+  char *buf = NULL;
+  size_t cap = 4096, len = 0;
+  const char *base = NULL;
+  struct stat st, target;
 
-  fprintf(config_file, "{\n");
+  CHECK(IS_PROFILE(profile),"Not a profile.");
+  if(_co_profile_saved(profile, path))
+  {
+    DEBUG("Profile unchanged since it was saved to %s.", path);
+    return 1;
+  }
 
-  _co_profile_export_file_r(((co_profile_t*)profile)->data, co_tree_root(((co_profile_t*)profile)->data), &count, config_file);
+  CHECK((values = co_profile_values(profile)) != NULL, "Failed to read profile.");
+  CHECK_MEM(buf = h_malloc(cap));
+  len = snprintf(buf, cap, "{\n");
+  CHECK(_co_profile_export_r(co_tree_root(values), &buf, &cap, &len), "Failed to export profile.");
+  if(cap - len < sizeof("\n}"))
+    CHECK_MEM(buf = h_realloc(buf, cap += sizeof("\n}")));
+  len += snprintf(buf + len, cap - len, "%s}", len > sizeof("{\n") - 1 ? "\n" : "");
+
+  /* A dotfile, so the profile watcher leaves it alone until it's renamed */
+  base = strrchr(path, '/');
+  base = (base != NULL) ? base + 1 : path;
+  CHECK(snprintf(tmp, sizeof(tmp), "%.*s.%s.tmp", (int)(base - path), path, base) < (int)sizeof(tmp), "Path %s too long.", path);
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0, "Config file %s could not be opened", tmp);
+  /* Replacing the file mustn't change who can read it */
+  if(stat(path, &target) == 0)
+  {
+    CHECK(fchmod(fd, target.st_mode & 07777) == 0, "Failed to set mode of %s.", tmp);
+    if(geteuid() == 0)
+      CHECK(fchown(fd, target.st_uid, target.st_gid) == 0, "Failed to set owner of %s.", tmp);
+  }
+  for(size_t off = 0; off < len; )
+  {
+    ssize_t w = write(fd, buf + off, len - off);
+    if(w < 0 && errno == EINTR) continue;
+    CHECK(w > 0, "Failed to write %s.", tmp);
+    off += w;
+  }
+  CHECK(fsync(fd) == 0, "Failed to sync %s.", tmp);
+  CHECK(fstat(fd, &st) == 0, "Failed to stat %s.", tmp);
+  int closed = close(fd);
+  fd = -1;
+  CHECK(closed == 0, "Failed to write %s.", tmp);
+  CHECK(rename(tmp, path) == 0, "Failed to replace %s.", path);
+  tmp[0] = '\0';
+
+  /* Sync the directory too, or the rename itself may not survive a crash */
+  if(base == path)
+    snprintf(tmp, sizeof(tmp), ".");
+  else
+    snprintf(tmp, sizeof(tmp), "%.*s", (int)(base - path), path);
+  if((fd = open(tmp, O_RDONLY | O_DIRECTORY)) < 0 || fsync(fd) != 0)
+    WARN("Failed to sync directory %s.", tmp);
+  if(fd >= 0) close(fd);
+  fd = -1;
+  tmp[0] = '\0';
+
+  _co_profile_unsave(profile);
+  saved.dev = st.st_dev;
+  saved.ino = st.st_ino;
+  saved.mtime = _co_profile_mtime(&st);
+  saved.size = st.st_size;
+  if((p->saved = co_bin8_create((char *)&saved, sizeof(saved), 0)) != NULL)
+    hattach(p->saved, p);
+  ret = 1;
 
-  fprintf(config_file, "}");
-  fclose (config_file); 
-  return 1;
 error:
-  return 0;
+  if(fd >= 0) close(fd);
+  if(tmp[0] != '\0') unlink(tmp);
+  if(values != NULL) co_obj_free(values);
+  if(buf != NULL) h_free(buf);
+  return ret;
 }
 
 co_obj_t *
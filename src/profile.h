@@ -35,8 +35,31 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <netinet/in.h>
 #include "obj.h"
 
+#define PROFILE_LOAD_THREADS 4
+#define PROFILE_CACHE "profiles.cache"
+#define PROFILE_HOOKS_MAX 8
+#define PROFILE_JOURNAL_MAX 256
+
+/* Kinds of change kept in the profile journal */
+#define PROFILE_CHANGE_SET 0
+#define PROFILE_CHANGE_ADD 1
+#define PROFILE_CHANGE_REMOVE 2
+#define PROFILE_CHANGE_RELOAD 3
+
+/* Value types a schema can declare for a key. The type is kept in the flags
+ * of the key's schema default. */
+#define PROFILE_STR 0
+#define PROFILE_BOOL 1
+#define PROFILE_UINT 2
+#define PROFILE_IPV4 3
+#define PROFILE_MAC 4
+#define PROFILE_ENUM 5
+#define PROFILE_TYPE(O) ((co_obj_getflags(O) >> 4) & 0x0f)
+#define PROFILE_MAC_SIZE 6
+
 #define SCHEMA(N) static int schema_##N(co_obj_t *self, co_obj_t **output, co_obj_t *params)
 
 #define SCHEMA_ADD(K, V) ({ \
@@ -45,6 +68,10 @@
     co_obj_free(val); \
   })
 
+#define SCHEMA_ADD_TYPED(K, V, T) co_schema_add(self, K, sizeof(K), V, sizeof(V), T, NULL, 0)
+
+#define SCHEMA_ADD_ENUM(K, V, C) co_schema_add(self, K, sizeof(K), V, sizeof(V), PROFILE_ENUM, C, sizeof(C))
+
 #define SCHEMA_REGISTER(N) co_schema_register(schema_##N)
 
 #define SCHEMA_GLOBAL(N) co_schema_register_global(schema_##N)
@@ -71,7 +98,11 @@ struct co_profile_t {
   uint8_t _exttype;
   uint8_t _len;
   co_obj_t *name; /**< command name */
-  co_obj_t *data;
+  co_obj_t *data; /**< values set on this profile */
+  co_obj_t *defaults; /**< shared, read-only schema template for keys not in data */
+  co_obj_t *saved; /**< identity of the file last exported to, NULL once the profile changes */
+  co_obj_t *derived; /**< values computed from this profile's, dropped when it changes */
+  uint64_t version; /**< profiles version of this profile's last change, 0 if none */
 } __attribute__((packed));
 
 /**
@@ -86,6 +117,20 @@ int co_schema_register(co_cb_t cb);
  */
 int co_schema_register_global(co_cb_t cb);
 
+/**
+ * @brief adds a typed key to a schema; used through SCHEMA_ADD_TYPED and
+ * SCHEMA_ADD_ENUM
+ * @param self schema being populated
+ * @param key key name
+ * @param klen key length
+ * @param value default value, as text
+ * @param vlen value length
+ * @param type one of the PROFILE_* value types
+ * @param choices for PROFILE_ENUM, the allowed values separated by '|'
+ * @param clen length of choices
+ */
+int co_schema_add(co_obj_t *self, const char *key, const size_t klen, const char *value, const size_t vlen, const int type, const char *choices, const size_t clen);
+
 /**
  * @brief load schemas for specified profile
  * @param profile profile to load schemas for
@@ -109,23 +154,119 @@ int co_profiles_init(const size_t index_size);
 void co_profiles_shutdown(void);
 
 /**
- * @brief imports available profiles from profiles directory
+ * @brief imports available profiles from profiles directory, parsing them on
+ * up to PROFILE_LOAD_THREADS threads and registering them in name order.
+ * Files that fail to parse are skipped.
  * @param path file path to the profiles directory
  */
 int co_profile_import_files(const char *path);
 
+/**
+ * @brief imports available profiles like co_profile_import_files, but takes
+ * profiles whose files are unchanged since the last import from a binary
+ * cache instead of parsing them, and rewrites the cache if anything changed
+ * @param path file path to the profiles directory
+ * @param cache file path to the profile cache
+ */
+int co_profile_import_files_cached(const char *path, const char *cache);
+
 /**
  * @brief imports global profile
  * @param path file path to the global profile
  */
 int co_profile_import_global(const char *path);
 
+/**
+ * @brief frees the profiles replaced by co_profile_reload,
+ * co_profile_reload_global and co_profile_import_global. Only call it when
+ * nothing can still point into them: no command running, and no response
+ * waiting to be sent.
+ */
+void co_profiles_collect(void);
+
+/**
+ * @brief called after a profile was reloaded or removed
+ * @param name profile name ("global" for the global profile)
+ * @param profile the new profile, or NULL if it was removed
+ * @param context pointer given to co_profile_hook
+ */
+typedef void (*co_profile_hook_t)(const char *name, co_obj_t *profile, void *context);
+
+/**
+ * @brief registers a hook run whenever co_profile_reload or
+ * co_profile_reload_global replaces a profile
+ * @param cb hook to run
+ * @param context pointer passed to the hook
+ * @return 0 if PROFILE_HOOKS_MAX hooks are already registered
+ */
+int co_profile_hook(co_profile_hook_t cb, void *context);
+
+/**
+ * @brief called for each journalled profile change, oldest first
+ * @param version profiles version the change produced
+ * @param change one of the PROFILE_CHANGE_* kinds
+ * @param name profile name ("global" for the global profile)
+ * @param key key that was set, or NULL unless change is PROFILE_CHANGE_SET
+ * @param context pointer given to co_profiles_changes
+ */
+typedef void (*co_profile_change_t)(uint64_t version, int change, const char *name, const char *key, void *context);
+
+/**
+ * @brief returns the profiles version, bumped by every change to a loaded
+ * profile (setting a value, adding, removing or reloading a profile). Each
+ * run starts counting from its start time in the high 32 bits, so versions
+ * from an earlier run are never mistaken for current ones.
+ */
+uint64_t co_profiles_version(void);
+
+/**
+ * @brief returns the profiles version of the last change to a profile, or 0
+ * if it has not changed since it was loaded
+ * @param profile profile struct
+ */
+uint64_t co_profile_version(co_obj_t *profile);
+
+/**
+ * @brief runs cb for each change made after a profiles version. Only the
+ * last PROFILE_JOURNAL_MAX changes are kept.
+ * @param since profiles version the caller is up to date with
+ * @param cb callback run for each change
+ * @param context pointer passed to cb
+ * @return 0 if changes after since are no longer in the journal, or since
+ * is from an earlier run, in which case cb is not run and the caller must
+ * re-read the profiles
+ */
+int co_profiles_changes(const uint64_t since, co_profile_change_t cb, void *context);
+
+/**
+ * @brief re-parses one file in the profiles directory and swaps the result
+ * in for the loaded profile of that name, or removes the profile if the file
+ * is gone. The loaded profile is kept if the file fails to parse.
+ * @param path file path to the profiles directory
+ * @param filename name of the file (and profile)
+ */
+int co_profile_reload(const char *path, const char *filename);
+
+/**
+ * @brief re-parses the global configuration file and swaps it in for the
+ * loaded global profile
+ * @param path file path to the global configuration file
+ */
+int co_profile_reload_global(const char *path);
+
 /**
  * @brief searches the profile list for a specified profile
  * @param name profile name (search key)
  */
 co_obj_t *co_profile_find(co_obj_t *name);
 
+/**
+ * @brief looks up a profile by name without allocating a search key
+ * @param name profile name
+ * @param nlen length of profile name
+ */
+co_obj_t *co_profile_find_str(const char *name, const size_t nlen);
+
 /**
  * @brief returns the global profile
  */
@@ -165,7 +306,38 @@ void co_profile_dump(co_obj_t *profile);
 co_obj_t *co_profile_get(co_obj_t *profile, const co_obj_t *key);
 
 /**
- * @brief sets a specified profile value (if a string)
+ * @brief collects every value of a profile, its own and its schema defaults,
+ * into a new tree. The values are inserted unsafe, so freeing the tree
+ * leaves them alone.
+ * @param profile profile struct
+ */
+co_obj_t *co_profile_values(co_obj_t *profile);
+
+/**
+ * @brief adds a profile value to a tree (e.g. a response) under its key, in
+ * text form. String values are inserted unsafe; typed values are formatted
+ * into new strings owned by the tree.
+ * @param tree tree to add to
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ */
+int co_profile_insert_value(co_obj_t *tree, co_obj_t *profile, const char *key, const size_t klen);
+
+/**
+ * @brief checks whether co_profile_set_str would accept a value, without
+ * setting it
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ * @param value key's value, as text
+ * @param vlen value length
+ */
+int co_profile_check_str(co_obj_t *profile, const char *key, const size_t klen, const char *value, const size_t vlen);
+
+/**
+ * @brief sets a specified profile value from text, converting it to the type
+ * the schema declares for the key
  * @param profile profile struct
  * @param key key in profile
  * @param klen key length
@@ -217,6 +389,45 @@ int co_profile_set_uint(co_obj_t *profile, const char *key, const size_t klen, c
  */
 unsigned long co_profile_get_uint(co_obj_t *profile, const char *key, const size_t klen);
 
+/**
+ * @brief returns the key value (if a bool) from the profile. If no value set, returns the default value
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ * @return 1 or 0, or -1 on error
+ */
+int co_profile_get_bool(co_obj_t *profile, const char *key, const size_t klen);
+
+/**
+ * @brief returns the key value (if an IPv4 address) from the profile. If no value set, returns the default value
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ * @param output address
+ */
+int co_profile_get_ipv4(co_obj_t *profile, const char *key, const size_t klen, struct in_addr *output);
+
+/**
+ * @brief returns the key value (if a MAC address) from the profile. If no value set, returns the default value
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ * @param output buffer of PROFILE_MAC_SIZE bytes
+ */
+int co_profile_get_mac(co_obj_t *profile, const char *key, const size_t klen, unsigned char *output);
+
+/**
+ * @brief writes the key value of any type from the profile as text, the way
+ * it is exported. If no value set, writes the default value
+ * @param profile profile struct
+ * @param key key in profile
+ * @param klen key length
+ * @param output output buffer
+ * @param size size of output buffer
+ * @return length written, including the terminating NUL, or -1
+ */
+ssize_t co_profile_get_text(co_obj_t *profile, const char *key, const size_t klen, char *output, const size_t size);
+
 /**
  * @brief sets a specified profile value (if a float)
  * @param profile profile struct
@@ -235,7 +446,36 @@ int co_profile_set_float(co_obj_t *profile, const char *key, const size_t klen,
 double co_profile_get_float(co_obj_t *profile, const char *key, const size_t klen);
 
 /**
- * @brief exports a profile in memory to a file
+ * @brief returns a value previously derived from the profile's values (e.g.
+ * a generated address) and stored with co_profile_set_derived, unless the
+ * profile has changed since
+ * @param profile profile struct
+ * @param key name of the derived value
+ * @param klen key length
+ */
+co_obj_t *co_profile_get_derived(co_obj_t *profile, const char *key, const size_t klen);
+
+/**
+ * @brief stores a value derived from the profile's values, until the
+ * profile next changes
+ * @param profile profile struct
+ * @param key name of the derived value
+ * @param klen key length
+ * @param value derived value, owned (or freed, on failure) by the profile
+ */
+int co_profile_set_derived(co_obj_t *profile, const char *key, const size_t klen, co_obj_t *value);
+
+/**
+ * @brief drops the derived values of every profile, for when something they
+ * were derived from outside the profiles (e.g. the node id) changes
+ */
+void co_profiles_clear_derived(void);
+
+/**
+ * @brief exports a profile in memory to a file. The file is written to a
+ * temporary file beside it, synced and renamed over it, so a crash leaves
+ * either the old or the new contents. Does nothing if the profile has not
+ * changed since it was last exported to path.
  * @param profile profile struct
  * @param path export path
  */
@@ -31,18 +31,24 @@
  * =====================================================================================
  */
 
+#define _GNU_SOURCE // accept4
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include "debug.h"
 #include "socket.h"
 #include "util.h"
 #include "list.h"
+#include "tree.h"
 
 co_obj_t *co_fd_create(co_obj_t *parent, int fd) {
   CHECK(IS_SOCK(parent),"Parent is not a socket.");
@@ -63,6 +69,83 @@ co_socket_t unix_socket_proto = {
   .connect = unix_socket_connect
 };
 
+co_socket_t unix_seqpacket_socket_proto = {
+  .init = unix_seqpacket_socket_init,
+  .bind = unix_seqpacket_socket_bind,
+  .connect = unix_seqpacket_socket_connect
+};
+
+co_socket_t tcp_socket_proto = {
+  .init = tcp_socket_init,
+  .bind = tcp_socket_bind,
+  .connect = tcp_socket_connect
+};
+
+co_socket_t udp_socket_proto = {
+  .init = udp_socket_init,
+  .bind = udp_socket_bind,
+  .connect = udp_socket_connect,
+  .send = udp_socket_send,
+  .receive = udp_socket_receive
+};
+
+/** monotonic seconds, for connection idle tracking */
+static time_t _co_socket_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/** returns the part of uri after scheme, or uri itself if it has another scheme */
+static const char *_co_socket_endpoint(const char *uri, const char *scheme) {
+  size_t slen = strlen(scheme);
+  if(strncmp(uri, scheme, slen) == 0) return uri + slen;
+  return uri;
+}
+
+static void _co_socket_set_uri(co_socket_t *this, const char *scheme, const char *endpoint) {
+  size_t len = strlen(scheme) + strlen(endpoint) + 1;
+  char *uri = h_malloc(len);
+  if(uri == NULL) return;
+  snprintf(uri, len, "%s%s", scheme, endpoint);
+  if(this->uri) h_free(this->uri);
+  this->uri = uri;
+  hattach(this->uri, this);
+}
+
+/** blocks for up to SOCKET_TIMEOUT for a non-blocking connect to finish */
+static int _co_socket_wait_connect(int fd) {
+  struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+  int err = 0;
+  socklen_t errlen = sizeof(err);
+  CHECK(poll(&pfd, 1, SOCKET_TIMEOUT * 1000) == 1, "Timed out connecting.");
+  CHECK(!getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen), "Failed to get connect status.");
+  errno = err;
+  CHECK(err == 0, "Failed to connect.");
+  return 1;
+error:
+  return 0;
+}
+
+/** sets the timeouts and blocking mode used by sockets outside the event loop */
+static void _co_socket_set_blocking(int fd) {
+  struct timeval timeout = { .tv_sec = SOCKET_TIMEOUT, .tv_usec = 0 };
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout));
+}
+
+co_obj_t *co_socket_create_uri(const char *uri) {
+  CHECK_MEM(uri);
+  if(strncmp(uri, "tcp://", sizeof("tcp://") - 1) == 0) return NEW(co_socket, tcp_socket);
+  if(strncmp(uri, "udp://", sizeof("udp://") - 1) == 0) return NEW(co_socket, udp_socket);
+  if(strncmp(uri, "unix+seqpacket://", sizeof("unix+seqpacket://") - 1) == 0) return NEW(co_socket, unix_seqpacket_socket);
+  return NEW(co_socket, unix_socket);
+error:
+  return NULL;
+}
+
 co_obj_t *co_socket_create(size_t size, co_socket_t proto) {
 
   if(!proto.init) proto.init = NULL;
@@ -100,26 +183,40 @@ int co_socket_init(co_obj_t* self) {
     hattach(this->remote,this);
     this->fd = (co_fd_t*)co_fd_create((co_obj_t*)this,-1);
     hattach(this->fd,this);
-    this->rfd_lst = co_list16_create();
-    hattach(this->rfd_lst,this);
+    this->rfds = NULL;
+    this->rfd_count = 0;
     this->fd_registered = false;
     this->listen = false;
+    this->max_connections = MAX_CONNECTIONS;
     this->events = 0;
     return 1;
   } else return 0;
 }
 
-static co_obj_t *_co_socket_close_fd_i(co_obj_t *list, co_obj_t *fd, void *context) {
-  if (IS_FD(fd))
-    close(((co_fd_t*)fd)->fd);
-  return NULL;
+static void _co_socket_link_rfd(co_socket_t *this, co_fd_t *fd) {
+  fd->prev = NULL;
+  fd->next = this->rfds;
+  if (this->rfds) this->rfds->prev = fd;
+  this->rfds = fd;
+  this->rfd_count++;
+  hattach(fd, this);
+}
+
+static void _co_socket_unlink_rfd(co_socket_t *this, co_fd_t *fd) {
+  if (fd->prev) fd->prev->next = fd->next;
+  else this->rfds = fd->next;
+  if (fd->next) fd->next->prev = fd->prev;
+  fd->prev = fd->next = NULL;
+  this->rfd_count--;
+  hattach(fd, NULL);
 }
 
 int co_socket_destroy(co_obj_t* self) {
   if(self && IS_SOCK(self)) {
     co_socket_t *this = (co_socket_t*)self;
     if (this->fd->fd > 0) close(this->fd->fd);
-    co_list_parse(this->rfd_lst,_co_socket_close_fd_i,NULL);
+    for (co_fd_t *rfd = this->rfds; rfd != NULL; rfd = rfd->next)
+      close(rfd->fd);
     co_obj_free(self);
     return 1;
   } else return 0;
@@ -134,13 +231,18 @@ int co_socket_hangup(co_obj_t *self, co_obj_t *context) {
   CHECK(fd->socket == this,"FD does not match socket");
   if (fd == this->fd) {
     CHECK(close(fd->fd) != -1,"Failed to close socket.");
+    fd->fd = -1;
     this->fd_registered = false;
     this->listen = false;
   } else {
-    CHECK(co_list_contains(this->rfd_lst,(co_obj_t*)fd),"Socket does not contain FD");
-    fd = (co_fd_t*)co_list_delete(this->rfd_lst,(co_obj_t*)fd);
+    CHECK(fd->prev != NULL || this->rfds == fd,"Socket does not contain FD");
+    _co_socket_unlink_rfd(this, fd);
     CHECK(close(fd->fd) != -1,"Failed to close socket.");
-    co_obj_free((co_obj_t*)fd);
+    /* A worker still holds this fd; its completion sees fd == -1 and frees it. */
+    if (fd->pending > 0)
+      fd->fd = -1;
+    else
+      co_obj_free((co_obj_t*)fd);
   }
   return 1;
 error:
@@ -148,23 +250,202 @@ error:
   return 0;
 }
 
+int co_socket_evict_idle(co_obj_t *self, const time_t max_idle) {
+  CHECK_MEM(self);
+  CHECK(IS_SOCK(self),"Not a socket.");
+  co_socket_t *this = (co_socket_t*)self;
+  co_fd_t *fd = this->rfds, *next = NULL;
+  time_t cutoff = _co_socket_now() - max_idle;
+  int evicted = 0;
+
+  for (; fd != NULL; fd = next) {
+    next = fd->next; // hangup unlinks fd
+    if (fd->last_active >= cutoff) continue;
+    INFO("Evicting idle connection (fd=%d) on %s.", fd->fd, this->uri);
+    CHECK(this->hangup(self, (co_obj_t*)fd), "Failed to evict idle connection.");
+    evicted++;
+  }
+  return evicted;
+
+error:
+  return -1;
+}
+
+/** hangs up the connection idle the longest, if any has nothing in flight */
+static int _co_socket_evict_oldest(co_socket_t *this) {
+  co_fd_t *oldest = NULL;
+  for (co_fd_t *fd = this->rfds; fd != NULL; fd = fd->next)
+    if (fd->pending == 0 && fd->outlen == 0 && (oldest == NULL || fd->last_active < oldest->last_active))
+      oldest = fd;
+  if (oldest == NULL) return 0;
+  INFO("Evicting connection (fd=%d) on %s to make room.", oldest->fd, this->uri);
+  return this->hangup((co_obj_t*)this, (co_obj_t*)oldest);
+}
+
+int co_socket_resume(co_obj_t *self) {
+  CHECK_MEM(self);
+  CHECK(IS_SOCK(self),"Not a socket.");
+  co_socket_t *this = (co_socket_t*)self;
+  if (!this->fd->paused) return 1;
+  DEBUG("Resuming accepting on %s.", this->uri);
+  this->fd->paused = false;
+  if (this->update_cb) CHECK(this->update_cb(self, (co_obj_t*)this->fd), "Failed to resume %s.", this->uri);
+  return 1;
+
+error:
+  return 0;
+}
+
+static int
+_co_fd_queue(co_fd_t *fd, const char *data, const size_t length)
+{
+  if(fd->outlen + length > fd->outcap) {
+    size_t cap = fd->outcap ? fd->outcap : SOCKET_OUTPUT_CHUNK;
+    while(cap < fd->outlen + length) cap *= 2;
+    char *buf = h_realloc(fd->outbuf, cap);
+    CHECK_MEM(buf);
+    if(fd->outbuf == NULL) hattach(buf, fd);
+    fd->outbuf = buf;
+    fd->outcap = cap;
+  }
+  memmove(fd->outbuf + fd->outlen, data, length);
+  fd->outlen += length;
+  return 1;
+error:
+  return 0;
+}
+
+/** caches the peer's credentials, so authorizing a request needs no syscall */
+static void _co_fd_peercred(co_fd_t *fd) {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if(getsockopt(fd->fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+    WARN("Failed to get peer credentials on FD %d.", fd->fd);
+    return;
+  }
+  fd->cred = true;
+  fd->pid = cred.pid;
+  fd->uid = cred.uid;
+  fd->gid = cred.gid;
+  fd->privileged = (cred.uid == 0 || cred.uid == geteuid());
+  DEBUG("Peer on FD %d is pid %d, uid %d, gid %d.", fd->fd, (int)cred.pid, (int)cred.uid, (int)cred.gid);
+}
+
+void co_fd_account(co_obj_t *self, const uint64_t latency) {
+  if(!IS_FD(self)) return;
+  co_fd_t *this = (co_fd_t*)self;
+  this->requests++;
+  if(latency > this->max_latency) this->max_latency = latency;
+}
+
+co_obj_t *co_socket_connections(co_obj_t *self) {
+  co_obj_t *tree = NULL, *conn = NULL;
+  char key[16];
+  CHECK(IS_SOCK(self),"Not a socket.");
+  co_socket_t *this = (co_socket_t*)self;
+  CHECK_MEM(tree = co_tree16_create());
+  time_t now = _co_socket_now();
+
+  for (co_fd_t *fd = this->rfds; fd != NULL; fd = fd->next) {
+    CHECK_MEM(conn = co_tree16_create());
+    co_tree_insert(conn, "bytes_in", sizeof("bytes_in"), co_uint64_create(fd->bytes_in, 0));
+    co_tree_insert(conn, "bytes_out", sizeof("bytes_out"), co_uint64_create(fd->bytes_out, 0));
+    co_tree_insert(conn, "requests", sizeof("requests"), co_uint32_create(fd->requests, 0));
+    co_tree_insert(conn, "idle", sizeof("idle"), co_uint64_create(now - fd->last_active, 0));
+    co_tree_insert(conn, "queued", sizeof("queued"), co_uint64_create(fd->outlen, 0));
+    co_tree_insert(conn, "max_latency", sizeof("max_latency"), co_uint64_create(fd->max_latency, 0));
+    co_tree_insert(conn, "throttled", sizeof("throttled"), co_uint8_create(fd->throttled, 0));
+    if(fd->cred) {
+      co_tree_insert(conn, "pid", sizeof("pid"), co_int32_create(fd->pid, 0));
+      co_tree_insert(conn, "uid", sizeof("uid"), co_uint32_create(fd->uid, 0));
+    }
+    snprintf(key, sizeof(key), "%d", fd->fd);
+    co_tree_insert(tree, key, strlen(key) + 1, conn);
+  }
+  return tree;
+error:
+  if(tree) co_obj_free(tree);
+  return NULL;
+}
+
 int co_socket_send(co_obj_t *self, char *outgoing, size_t length) {
   CHECK_MEM(self);
   CHECK(IS_FD(self),"Not a FD.");
   co_fd_t *this = (co_fd_t*)self;
-  unsigned int sent = 0;
-  unsigned int remaining = length;
-  int n;
-
-  while(sent < length) {
-    n = send(this->fd, outgoing+sent, remaining, 0);
-    if(n < 0) break;
-    sent += n;
-    remaining -= n;
+  const bool managed = (this->socket != NULL && this->socket->update_cb != NULL);
+  const int flags = managed ? (MSG_DONTWAIT | MSG_NOSIGNAL) : MSG_NOSIGNAL;
+  size_t sent = 0;
+  ssize_t n = 0;
+
+  /* Anything already queued has to go out first to keep messages in order. */
+  if(this->outlen == 0 && this->message) {
+    while((n = send(this->fd, outgoing, length, flags)) < 0 && errno == EINTR);
+    if(n >= 0) sent = length;
+    else if(!managed || (errno != EAGAIN && errno != EWOULDBLOCK))
+      SENTINEL("Failed to send on FD %d.", this->fd);
+  } else if(this->outlen == 0) {
+    while(sent < length) {
+      n = send(this->fd, outgoing + sent, length - sent, flags);
+      if(n < 0) {
+        if(errno == EINTR) continue;
+        if(managed && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        SENTINEL("Failed to send on FD %d.", this->fd);
+      }
+      sent += n;
+    }
+  }
+
+  this->bytes_out += sent;
+  if(sent < length) {
+    /* Messages are queued whole, each behind its length */
+    if(this->message)
+      CHECK(_co_fd_queue(this, (char*)&length, sizeof(length)), "Failed to queue output on FD %d.", this->fd);
+    CHECK(_co_fd_queue(this, outgoing + sent, length - sent), "Failed to queue output on FD %d.", this->fd);
+    this->socket->update_cb((co_obj_t*)this->socket, self);
   }
 
-  DEBUG("Sent %d bytes.", sent);
-  return sent;
+  DEBUG("Sent %d bytes, queued %d bytes.", (int)sent, (int)(length - sent));
+  return length;
+
+error:
+  return -1;
+}
+
+int co_socket_flush(co_obj_t *self) {
+  CHECK_MEM(self);
+  CHECK(IS_FD(self),"Not a FD.");
+  co_fd_t *this = (co_fd_t*)self;
+  size_t sent = 0;
+  ssize_t n = 0;
+
+  size_t mlen = 0;
+
+  while(sent < this->outlen) {
+    if(this->message) {
+      memcpy(&mlen, this->outbuf + sent, sizeof(mlen));
+      n = send(this->fd, this->outbuf + sent + sizeof(mlen), mlen, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } else
+      n = send(this->fd, this->outbuf + sent, this->outlen - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+      SENTINEL("Failed to flush output on FD %d.", this->fd);
+    }
+    sent += this->message ? sizeof(mlen) + mlen : (size_t)n;
+    this->bytes_out += this->message ? mlen : (size_t)n;
+  }
+
+  if(sent > 0) {
+    memmove(this->outbuf, this->outbuf + sent, this->outlen - sent);
+    this->outlen -= sent;
+  }
+  if(this->outlen == 0 && this->outbuf != NULL) {
+    h_free(this->outbuf);
+    this->outbuf = NULL;
+    this->outcap = 0;
+  }
+  DEBUG("Flushed %d bytes, %d bytes still queued.", (int)sent, (int)this->outlen);
+  return this->outlen;
 
 error:
   return -1;
@@ -177,18 +458,45 @@ int co_socket_receive(co_obj_t *self, co_obj_t *fd, char *incoming, size_t lengt
   CHECK(((co_fd_t*)fd)->socket == this,"FD does not match socket");
   int received = 0;
   int rfd = 0;
+  bool evicted = false;
   if(this->listen) {
     DEBUG("Receiving on listening socket.");
     if((co_fd_t*)fd == this->fd) {
-      socklen_t size = sizeof(*(this->remote));
-      DEBUG("Accepting connection (fd=%d).", this->fd->fd);
-      CHECK((rfd = accept(this->fd->fd, (struct sockaddr *) this->remote, &size)) != -1, "Failed to accept connection.");
-      DEBUG("Accepted connection (fd=%d).", rfd);
-      co_obj_t *new_rfd = co_fd_create((co_obj_t*)this,rfd);
-      CHECK(co_list_append(this->rfd_lst,new_rfd),"Failed to append rfd");
-      int flags = fcntl(rfd, F_GETFL, 0);
-      fcntl(rfd, F_SETFL, flags | O_NONBLOCK); //Set non-blocking.
-      if(this->register_cb) this->register_cb((co_obj_t*)this, new_rfd);
+      /* The listen fd is non-blocking, so take the whole backlog in one go */
+      while(true) {
+        socklen_t size = sizeof(struct sockaddr_un); // remote is at least this big for every proto
+        if((rfd = accept4(this->fd->fd, (struct sockaddr *) this->remote, &size, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1) {
+          if(errno == EINTR) continue;
+          if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+          /* Out of descriptors or buffers, which is no fault of the listening
+           * socket: make room once, else stop accepting until resumed, as
+           * the backlog would wake the loop again straight away */
+          if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+            if(!evicted && (evicted = _co_socket_evict_oldest(this))) continue;
+            WARN("Out of resources accepting on %s, pausing.", this->uri);
+            this->fd->paused = true;
+            if(this->update_cb) this->update_cb((co_obj_t*)this, (co_obj_t*)this->fd);
+            break;
+          }
+          /* The peer gave up while queued; the rest wait for the next wakeup */
+          if(errno == ECONNABORTED) break;
+          SENTINEL("Failed to accept connection.");
+        }
+        if(this->max_connections > 0 && this->rfd_count >= this->max_connections) {
+          WARN("Connection limit (%u) reached on %s, refusing FD %d.", this->max_connections, this->uri, rfd);
+          close(rfd);
+          continue;
+        }
+        DEBUG("Accepted connection (fd=%d).", rfd);
+        co_obj_t *new_rfd = co_fd_create((co_obj_t*)this,rfd);
+        CHECK_MEM(new_rfd);
+        ((co_fd_t*)new_rfd)->message = this->fd->message;
+        ((co_fd_t*)new_rfd)->last_active = _co_socket_now();
+        if(((struct sockaddr*)this->remote)->sa_family == AF_UNIX)
+          _co_fd_peercred((co_fd_t*)new_rfd);
+        _co_socket_link_rfd(this, (co_fd_t*)new_rfd);
+        if(this->register_cb) this->register_cb((co_obj_t*)this, new_rfd);
+      }
       return 0;
     } else {
       rfd = ((co_fd_t*)fd)->fd;
@@ -200,7 +508,12 @@ int co_socket_receive(co_obj_t *self, co_obj_t *fd, char *incoming, size_t lengt
   } else ERROR("No valid file descriptor found in socket!"); 
 
   DEBUG("Attempting to receive data on FD %d.", rfd);
-  CHECK((received = recv(rfd, incoming, length, 0)) >= 0, "Error receiving data from socket.");
+  /* A peer that reset the connection has closed it just as one sending
+   * end-of-file has */
+  if((received = recv(rfd, incoming, length, 0)) < 0 && errno == ECONNRESET) received = 0;
+  CHECK(received >= 0, "Error receiving data from socket.");
+  ((co_fd_t*)fd)->last_active = _co_socket_now();
+  ((co_fd_t*)fd)->bytes_in += received;
   return received;
 
 error:
@@ -246,8 +559,8 @@ int unix_socket_init(co_obj_t *self) {
     co_socket_t *this = (co_socket_t*)self;
     this->fd = (co_fd_t*)co_fd_create((co_obj_t*)this,-1);
     hattach(this->fd,this);
-    this->rfd_lst = co_list16_create();
-    hattach(this->rfd_lst,this);
+    this->rfds = NULL;
+    this->rfd_count = 0;
     this->local = h_calloc(1,sizeof(struct sockaddr_un));
     hattach(this->local,this);
     this->remote = h_calloc(1,sizeof(struct sockaddr_un));
@@ -256,30 +569,30 @@ int unix_socket_init(co_obj_t *self) {
     this->listen = false;
     this->uri = h_strdup("unix://");
     hattach(this->uri,this);
+    this->max_connections = MAX_CONNECTIONS;
     this->events = 0;
     return 1;
   } else return 0;
 }
 
-int unix_socket_bind(co_obj_t *self, const char *endpoint) {
+static int _unix_socket_bind(co_obj_t *self, const char *endpoint, int type) {
   DEBUG("Binding unix_socket %s.", endpoint);
   CHECK(IS_SOCK(self),"Not a socket.");
   unix_socket_t *this = (unix_socket_t*)self;
   struct sockaddr_un *address = (struct sockaddr_un *)this->_(local);
   CHECK_MEM(address);
   address->sun_family = AF_UNIX;
-  CHECK((sizeof(endpoint) <= sizeof(address->sun_path)), "Endpoint %s is too large for socket path.", endpoint);
+  CHECK(strlen(endpoint) < sizeof(address->sun_path), "Endpoint %s is too large for socket path.", endpoint);
   strcpy(address->sun_path, endpoint);
   unlink(address->sun_path);
 
   //Initialize socket.
-  CHECK((this->_(fd)->fd = socket(AF_UNIX, SOCK_STREAM, 0)) != -1, "Failed to grab Unix socket file descriptor.");
+  CHECK((this->_(fd)->fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) != -1, "Failed to grab Unix socket file descriptor.");
+  this->_(fd)->message = (type == SOCK_SEQPACKET);
 
   //Set some default socket options.
 	const int optval = 1;
 	setsockopt(this->_(fd)->fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
-  //int flags = fcntl(this->_(fd)->fd, F_GETFL, 0);
-  //fcntl(this->_(fd)->fd, F_SETFL, flags | O_NONBLOCK); //Set non-blocking.
   //Set default timeout
   struct timeval timeout;
   timeout.tv_sec = 5;
@@ -292,27 +605,29 @@ int unix_socket_bind(co_obj_t *self, const char *endpoint) {
 	CHECK(!bind(this->_(fd)->fd, (struct sockaddr *) address, size), "Failed to bind Unix socket %s.", address->sun_path);
   CHECK(!listen(this->_(fd)->fd, SOMAXCONN), "Failed to listen on Unix socket %s.", address->sun_path);
   this->_(listen) = true;
+  _co_socket_set_uri((co_socket_t*)this, type == SOCK_SEQPACKET ? "unix+seqpacket://" : "unix://", endpoint);
   if(this->_(register_cb)) this->_(register_cb)((co_obj_t*)this, (co_obj_t*)this->_(fd));
   return 1;
 
 error:
-	close(this->_(fd)->fd);
+  if(this->_(fd)->fd != -1) close(this->_(fd)->fd);
+  this->_(fd)->fd = -1;
   return 0;
 }
 
-int unix_socket_connect(co_obj_t *self, const char *endpoint) {
+static int _unix_socket_connect(co_obj_t *self, const char *endpoint, int type) {
   DEBUG("Connecting unix_socket %s.", endpoint);
   CHECK(IS_SOCK(self),"Not a socket.");
   unix_socket_t *this = (unix_socket_t*)self;
   struct sockaddr_un address = { .sun_family = AF_UNIX };
-  FILE *f = NULL;
 
-  CHECK((sizeof(endpoint) <= sizeof(address.sun_path)), "Endpoint %s is too large for socket path.", endpoint);
-  CHECK(!(f = fopen(endpoint, "r")), "Invalid socket file path.");
+  /* A missing or stale path just fails connect() below */
+  CHECK(strlen(endpoint) < sizeof(address.sun_path), "Endpoint %s is too large for socket path.", endpoint);
   strcpy(address.sun_path, endpoint);
 
   //Initialize socket.
-  CHECK((this->_(fd)->fd = socket(AF_UNIX, SOCK_STREAM, 0)) != -1, "Failed to grab Unix socket file descriptor.");
+  CHECK((this->_(fd)->fd = socket(AF_UNIX, type, 0)) != -1, "Failed to grab Unix socket file descriptor.");
+  this->_(fd)->message = (type == SOCK_SEQPACKET);
 
   //Set some default socket options.
 	const int optval = 1;
@@ -328,10 +643,229 @@ int unix_socket_connect(co_obj_t *self, const char *endpoint) {
 
   //Bind socket to file descriptor.
 	CHECK(!connect(this->_(fd)->fd, (struct sockaddr *) &address, sizeof(address)) || errno == EINPROGRESS, "Failed to bind Unix socket.");
+  _co_socket_set_uri((co_socket_t*)this, type == SOCK_SEQPACKET ? "unix+seqpacket://" : "unix://", endpoint);
+  return 1;
+
+error:
+  if(this->_(fd)->fd >= 0) close(this->_(fd)->fd);
+  this->_(fd)->fd = -1;
+  return 0;
+}
+
+
+int unix_socket_bind(co_obj_t *self, const char *endpoint) {
+  return _unix_socket_bind(self, _co_socket_endpoint(endpoint, "unix://"), SOCK_STREAM);
+}
+
+int unix_socket_connect(co_obj_t *self, const char *endpoint) {
+  return _unix_socket_connect(self, _co_socket_endpoint(endpoint, "unix://"), SOCK_STREAM);
+}
+
+int unix_seqpacket_socket_init(co_obj_t *self) {
+  CHECK(unix_socket_init(self), "Failed to initialize socket.");
+  co_socket_t *this = (co_socket_t*)self;
+  h_free(this->uri);
+  this->uri = h_strdup("unix+seqpacket://");
+  hattach(this->uri, this);
+  return 1;
+error:
+  return 0;
+}
+
+int unix_seqpacket_socket_bind(co_obj_t *self, const char *endpoint) {
+  return _unix_socket_bind(self, _co_socket_endpoint(endpoint, "unix+seqpacket://"), SOCK_SEQPACKET);
+}
+
+int unix_seqpacket_socket_connect(co_obj_t *self, const char *endpoint) {
+  return _unix_socket_connect(self, _co_socket_endpoint(endpoint, "unix+seqpacket://"), SOCK_SEQPACKET);
+}
+
+/** resolves host:port or [host]:port; an empty host binds every address */
+static int _inet_socket_resolve(const char *endpoint, int socktype, int flags, struct addrinfo **result) {
+  char host[NI_MAXHOST] = {0};
+  const char *port = NULL, *end = NULL;
+  struct addrinfo hints;
+  int ret = 0;
+
+  if(endpoint[0] == '[') {
+    CHECK((end = strchr(endpoint, ']')) != NULL && end[1] == ':', "Invalid endpoint %s.", endpoint);
+    CHECK(end - endpoint - 1 < sizeof(host), "Host too long in endpoint %s.", endpoint);
+    memcpy(host, endpoint + 1, end - endpoint - 1);
+    port = end + 2;
+  } else {
+    CHECK((end = strrchr(endpoint, ':')) != NULL, "No port in endpoint %s.", endpoint);
+    CHECK(end - endpoint < sizeof(host), "Host too long in endpoint %s.", endpoint);
+    memcpy(host, endpoint, end - endpoint);
+    port = end + 1;
+  }
+  CHECK(*port != '\0', "No port in endpoint %s.", endpoint);
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = socktype;
+  hints.ai_flags = flags;
+  CHECK((ret = getaddrinfo(host[0] ? host : NULL, port, &hints, result)) == 0, "Failed to resolve %s: %s", endpoint, gai_strerror(ret));
   return 1;
 
 error:
-	close(this->_(fd)->fd);
   return 0;
 }
 
+static int _inet_socket_init(co_obj_t *self, const char *scheme) {
+  CHECK(co_socket_init(self), "Failed to initialize socket.");
+  co_socket_t *this = (co_socket_t*)self;
+  this->uri = h_strdup(scheme);
+  hattach(this->uri, this);
+  ((inet_socket_t*)self)->addrlen = 0;
+  return 1;
+error:
+  return 0;
+}
+
+/** binds (and for stream sockets, listens on) the first usable address */
+static int _inet_socket_bind(co_obj_t *self, const char *endpoint, const char *scheme, int socktype) {
+  CHECK(IS_SOCK(self),"Not a socket.");
+  inet_socket_t *this = (inet_socket_t*)self;
+  struct addrinfo *result = NULL, *rp = NULL;
+  const int optval = 1;
+  endpoint = _co_socket_endpoint(endpoint, scheme);
+  DEBUG("Binding %s%s.", scheme, endpoint);
+
+  CHECK(_inet_socket_resolve(endpoint, socktype, AI_PASSIVE, &result), "Failed to resolve %s.", endpoint);
+  for(rp = result; rp != NULL; rp = rp->ai_next) {
+    if((this->_(fd)->fd = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, rp->ai_protocol)) == -1)
+      continue;
+    setsockopt(this->_(fd)->fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    if(!bind(this->_(fd)->fd, rp->ai_addr, rp->ai_addrlen) &&
+       (socktype != SOCK_STREAM || !listen(this->_(fd)->fd, SOMAXCONN)))
+      break;
+    close(this->_(fd)->fd);
+    this->_(fd)->fd = -1;
+  }
+  CHECK(rp != NULL, "Failed to bind %s%s.", scheme, endpoint);
+  memcpy(this->_(local), rp->ai_addr, rp->ai_addrlen);
+  this->addrlen = rp->ai_addrlen;
+  freeaddrinfo(result);
+  result = NULL;
+
+  if(socktype == SOCK_STREAM) {
+    /* Accepted connections inherit these */
+    setsockopt(this->_(fd)->fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+    setsockopt(this->_(fd)->fd, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+    this->_(listen) = true;
+  }
+  _co_socket_set_uri((co_socket_t*)this, scheme, endpoint);
+  if(this->_(register_cb)) this->_(register_cb)((co_obj_t*)this, (co_obj_t*)this->_(fd));
+  return 1;
+
+error:
+  if(result) freeaddrinfo(result);
+  return 0;
+}
+
+/** connects to the first reachable address without blocking; see tcp_socket_connect */
+static int _inet_socket_connect(co_obj_t *self, const char *endpoint, const char *scheme, int socktype) {
+  CHECK(IS_SOCK(self),"Not a socket.");
+  inet_socket_t *this = (inet_socket_t*)self;
+  struct addrinfo *result = NULL, *rp = NULL;
+  const int optval = 1, keepidle = SOCKET_KEEPIDLE;
+  endpoint = _co_socket_endpoint(endpoint, scheme);
+  DEBUG("Connecting %s%s.", scheme, endpoint);
+
+  CHECK(_inet_socket_resolve(endpoint, socktype, 0, &result), "Failed to resolve %s.", endpoint);
+  for(rp = result; rp != NULL; rp = rp->ai_next) {
+    if((this->_(fd)->fd = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, rp->ai_protocol)) == -1)
+      continue;
+    if(socktype == SOCK_STREAM) {
+      setsockopt(this->_(fd)->fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+      setsockopt(this->_(fd)->fd, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+      setsockopt(this->_(fd)->fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepidle, sizeof(keepidle));
+    }
+    if(!connect(this->_(fd)->fd, rp->ai_addr, rp->ai_addrlen) || errno == EINPROGRESS)
+      break;
+    close(this->_(fd)->fd);
+    this->_(fd)->fd = -1;
+  }
+  CHECK(rp != NULL, "Failed to connect %s%s.", scheme, endpoint);
+  memcpy(this->_(remote), rp->ai_addr, rp->ai_addrlen);
+  this->addrlen = rp->ai_addrlen;
+  freeaddrinfo(result);
+  result = NULL;
+  _co_socket_set_uri((co_socket_t*)this, scheme, endpoint);
+
+  if(this->_(register_cb)) {
+    /* The loop finishes the connect: queued output goes out on EPOLLOUT,
+     * and a refused connection comes back as EPOLLERR. */
+    CHECK(this->_(register_cb)((co_obj_t*)this, (co_obj_t*)this->_(fd)), "Failed to register %s.", this->_(uri));
+  } else {
+    CHECK(_co_socket_wait_connect(this->_(fd)->fd), "Failed to connect %s%s.", scheme, endpoint);
+    _co_socket_set_blocking(this->_(fd)->fd);
+  }
+  return 1;
+
+error:
+  if(result) freeaddrinfo(result);
+  if(this->_(fd)->fd != -1) close(this->_(fd)->fd);
+  this->_(fd)->fd = -1;
+  return 0;
+}
+
+int tcp_socket_init(co_obj_t *self) {
+  return _inet_socket_init(self, "tcp://");
+}
+
+int tcp_socket_bind(co_obj_t *self, const char *endpoint) {
+  return _inet_socket_bind(self, endpoint, "tcp://", SOCK_STREAM);
+}
+
+int tcp_socket_connect(co_obj_t *self, const char *endpoint) {
+  return _inet_socket_connect(self, endpoint, "tcp://", SOCK_STREAM);
+}
+
+int udp_socket_init(co_obj_t *self) {
+  return _inet_socket_init(self, "udp://");
+}
+
+int udp_socket_bind(co_obj_t *self, const char *endpoint) {
+  return _inet_socket_bind(self, endpoint, "udp://", SOCK_DGRAM);
+}
+
+int udp_socket_connect(co_obj_t *self, const char *endpoint) {
+  return _inet_socket_connect(self, endpoint, "udp://", SOCK_DGRAM);
+}
+
+int udp_socket_send(co_obj_t *self, char *outgoing, size_t length) {
+  CHECK_MEM(self);
+  CHECK(IS_FD(self),"Not a FD.");
+  co_fd_t *fd = (co_fd_t*)self;
+  inet_socket_t *this = (inet_socket_t*)fd->socket;
+  int flags = MSG_NOSIGNAL | (this->_(update_cb) ? MSG_DONTWAIT : 0);
+  ssize_t sent = 0;
+
+  /* Datagrams go whole or not at all, so there is nothing to queue */
+  if(this->addrlen > 0)
+    sent = sendto(fd->fd, outgoing, length, flags, this->_(remote), this->addrlen);
+  else
+    sent = send(fd->fd, outgoing, length, flags);
+  CHECK(sent == length, "Failed to send datagram on FD %d.", fd->fd);
+  return length;
+
+error:
+  return -1;
+}
+
+int udp_socket_receive(co_obj_t *self, co_obj_t *fd, char *incoming, size_t length) {
+  CHECK_MEM(self);
+  CHECK(IS_SOCK(self),"Not a socket.");
+  inet_socket_t *this = (inet_socket_t*)self;
+  CHECK(((co_fd_t*)fd)->socket == (co_socket_t*)this,"FD does not match socket");
+  socklen_t addrlen = sizeof(struct sockaddr_storage);
+  int received = 0;
+
+  CHECK((received = recvfrom(((co_fd_t*)fd)->fd, incoming, length, 0, this->_(remote), &addrlen)) >= 0, "Error receiving datagram.");
+  this->addrlen = addrlen;
+  return received;
+
+error:
+  return -1;
+}
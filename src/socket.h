@@ -37,11 +37,19 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
 #include <sys/socket.h>
 #include "obj.h"
 
 #define MAX_IPPROTO 255
 #define MAX_CONNECTIONS 32
+#define SOCKET_OUTPUT_CHUNK 4096
+#define SOCKET_HIGHWATER 65536
+#define SOCKET_LOWWATER 16384
+#define SOCKET_TIMEOUT 5 // seconds, for blocking (client) sockets
+#define SOCKET_KEEPIDLE 60 // seconds of idle before TCP keepalive probes
+#define SOCKET_IDLE_TIMEOUT 300 // seconds before an idle accepted connection is evicted
 
 typedef struct co_fd_t co_fd_t;
 typedef struct co_socket_t co_socket_t;
@@ -52,6 +60,29 @@ struct co_fd_t {
   uint8_t _len;
   co_socket_t *socket;  // parent socket
   int fd;
+  uint32_t events; // epoll events currently requested for this fd
+  bool throttled; // output queue passed SOCKET_HIGHWATER, stop reading
+  bool paused; // listening fd ran out of descriptors, stop accepting until resumed
+  char *outbuf; // output not yet accepted by the kernel
+  size_t outlen;
+  size_t outcap;
+  int pending; // worker jobs that will still reply on this fd
+  bool message; // SOCK_SEQPACKET: each send is one message, queued whole
+  time_t last_active; // CLOCK_MONOTONIC seconds of the last accept or receive
+  co_fd_t *prev; // neighbours in the parent socket's rfds list
+  co_fd_t *next;
+  uint64_t bytes_in; // received on this fd
+  uint64_t bytes_out; // accepted by the kernel on this fd
+  uint32_t requests; // requests answered
+  uint64_t max_latency; // slowest request, receive to reply, in microseconds
+  bool cred; // peer credentials below came from SO_PEERCRED at accept
+  pid_t pid;
+  uid_t uid;
+  gid_t gid;
+  bool privileged; // peer is root or our own user; may run non-public commands
+  char *inbuf; // start of a request that didn't fit in the last read
+  size_t inlen;
+  size_t incap;
 };
 
 /**
@@ -69,11 +100,13 @@ struct co_socket_t {
   uint8_t _len;
   char *uri;
   co_fd_t *fd; //socket file descriptor
-  co_obj_t *rfd_lst; //list of accepted socket file descriptors
+  co_fd_t *rfds; //accepted socket file descriptors, linked through co_fd_t prev/next
+  unsigned int rfd_count;
   bool fd_registered;
   struct sockaddr* local;
   struct sockaddr* remote;
   bool listen;
+  unsigned int max_connections; // accepted connections allowed at once, 0 for no limit
   int (*init)(co_obj_t *self);
   int (*destroy)(co_obj_t *self);
   int (*hangup)(co_obj_t *self, co_obj_t *context);
@@ -85,6 +118,7 @@ struct co_socket_t {
   int (*getopt)(co_obj_t *self, int level, int option, void *optval, socklen_t optvallen);
   int (*poll_cb)(co_obj_t *self, co_obj_t *context);
   int (*register_cb)(co_obj_t *self, co_obj_t *context);
+  int (*update_cb)(co_obj_t *self, co_obj_t *context);
   unsigned int events;
 } __attribute__((packed));
 
@@ -102,6 +136,16 @@ co_obj_t *co_socket_create(size_t size, co_socket_t proto);
  */
 int co_socket_init(co_obj_t *self);
 
+/**
+ * @brief creates a socket of the protocol named by a URI's scheme
+ * @details tcp:// and udp:// select tcp_socket_proto and udp_socket_proto,
+ * unix+seqpacket:// selects unix_seqpacket_socket_proto, and unix:// or a
+ * bare path selects unix_socket_proto. The whole URI can then
+ * be passed to the socket's bind or connect.
+ * @param uri URI string
+ */
+co_obj_t *co_socket_create_uri(const char *uri);
+
 /**
  * @brief closes a socket and removes it from memory
  * @param self socket name
@@ -115,19 +159,64 @@ int co_socket_destroy(co_obj_t *self);
  */
 int co_socket_hangup(co_obj_t *self, co_obj_t *context); 
 
+/**
+ * @brief hangs up accepted connections that haven't sent anything recently
+ * @param self listening socket
+ * @param max_idle seconds a connection may stay idle
+ * @return number of connections evicted, -1 on error
+ */
+int co_socket_evict_idle(co_obj_t *self, const time_t max_idle);
+
+/**
+ * @brief starts accepting again on a listening socket that receive paused
+ * @details receive pauses a listening socket when accepting fails for lack
+ * of descriptors or buffers and there is no idle connection to evict
+ * @param self listening socket
+ */
+int co_socket_resume(co_obj_t *self);
+
+/**
+ * @brief records a completed request on a connection
+ * @param self accepted connection
+ * @param latency microseconds from receiving the request to replying
+ */
+void co_fd_account(co_obj_t *self, const uint64_t latency);
+
+/**
+ * @brief builds a tree of accepted connections, keyed by fd, with their
+ * counters: bytes in/out, requests, idle seconds, queued output, max latency
+ * (microseconds), whether the client has stopped reading its output and,
+ * for local clients, the peer's pid and uid
+ * @param self listening socket
+ * @return a new tree, or NULL on error
+ */
+co_obj_t *co_socket_connections(co_obj_t *self);
+
 /**
  * @brief sends a message on a specified socket
+ * @details on descriptors managed by the event loop (update_cb set) the send
+ * never blocks: whatever the kernel does not accept is queued on the fd and
+ * written out when the loop reports EPOLLOUT
  * @param self commotion file descriptor
  * @param outgoing message to be sent
  * @param length length of message
  */
 int co_socket_send(co_obj_t *self, char *outgoing, size_t length);
 
+/**
+ * @brief writes as much queued output as the kernel will take without blocking
+ * @param self commotion file descriptor
+ * @return number of bytes still queued, or -1 on error
+ */
+int co_socket_flush(co_obj_t *self);
+
 /**
  * @brief receives a message on the listening socket
  * @param self socket name
  * @param incoming message received
  * @param length length of message
+ * @return bytes received, 0 once the peer has closed or reset the
+ * connection, -1 on error
  */
 int co_socket_receive(co_obj_t * self, co_obj_t *fd, char *incoming, size_t length);
 
@@ -152,6 +241,7 @@ int co_socket_setopt(co_obj_t * self, int level, int option, void *optval, sockl
 int co_socket_getopt(co_obj_t * self, int level, int option, void *optval, socklen_t optvallen);
 
 typedef struct unix_socket_t unix_socket_t;
+typedef struct unix_socket_t unix_seqpacket_socket_t;
 
 /**
  * @struct unix_socket_t struct for unix sockets. Contains protocol and file path to socket library
@@ -181,5 +271,102 @@ int unix_socket_bind(co_obj_t *self, const char *endpoint);
  */
 int unix_socket_connect(co_obj_t *self, const char *endpoint);
 
+/**
+ * @brief initializes a SOCK_SEQPACKET unix socket, which keeps message
+ * boundaries so that each receive returns exactly one request
+ * @param self socket name
+ */
+int unix_seqpacket_socket_init(co_obj_t *self);
+
+/**
+ * @brief binds a SOCK_SEQPACKET unix socket to a specified endpoint
+ * @param self socket name
+ * @param endpoint file path, optionally prefixed with unix+seqpacket://
+ */
+int unix_seqpacket_socket_bind(co_obj_t *self, const char *endpoint);
+
+/**
+ * @brief connects a SOCK_SEQPACKET unix socket to specified endpoint
+ * @param self socket name
+ * @param endpoint file path, optionally prefixed with unix+seqpacket://
+ */
+int unix_seqpacket_socket_connect(co_obj_t *self, const char *endpoint);
+
+typedef struct inet_socket_t inet_socket_t;
+typedef struct inet_socket_t tcp_socket_t;
+typedef struct inet_socket_t udp_socket_t;
+
+/**
+ * @struct inet_socket_t struct for TCP and UDP sockets. Contains protocol and
+ * the length of the addresses in local and remote
+ */
+struct inet_socket_t {
+  co_socket_t proto;
+  socklen_t addrlen;
+} __attribute__((packed));
+
+/**
+ * @brief initializes a TCP socket
+ * @param self socket name
+ */
+int tcp_socket_init(co_obj_t *self);
+
+/**
+ * @brief binds a TCP socket and listens on it
+ * @param self socket name
+ * @param endpoint host:port, optionally prefixed with tcp://
+ */
+int tcp_socket_bind(co_obj_t *self, const char *endpoint);
+
+/**
+ * @brief connects a TCP socket, with TCP_NODELAY and keepalive set
+ * @details the connect is non-blocking; a socket with a register_cb is
+ * handed to the event loop while it completes, otherwise this waits up to
+ * SOCKET_TIMEOUT for it and leaves the socket blocking
+ * @param self socket name
+ * @param endpoint host:port, optionally prefixed with tcp://
+ */
+int tcp_socket_connect(co_obj_t *self, const char *endpoint);
+
+/**
+ * @brief initializes a UDP socket
+ * @param self socket name
+ */
+int udp_socket_init(co_obj_t *self);
+
+/**
+ * @brief binds a UDP socket
+ * @param self socket name
+ * @param endpoint host:port, optionally prefixed with udp://
+ */
+int udp_socket_bind(co_obj_t *self, const char *endpoint);
+
+/**
+ * @brief sets the default peer of a UDP socket
+ * @param self socket name
+ * @param endpoint host:port, optionally prefixed with udp://
+ */
+int udp_socket_connect(co_obj_t *self, const char *endpoint);
+
+/**
+ * @brief sends a datagram to the socket's remote address (the sender of the
+ * last datagram received, or the connected peer). With one remote address
+ * per socket, a bound UDP socket can only answer one peer at a time, so the
+ * daemon does not accept udp:// as its management socket.
+ * @param self commotion file descriptor
+ * @param outgoing message to be sent
+ * @param length length of message
+ */
+int udp_socket_send(co_obj_t *self, char *outgoing, size_t length);
+
+/**
+ * @brief receives a datagram, remembering its sender as the remote address
+ * @param self socket name
+ * @param fd commotion file descriptor
+ * @param incoming buffer for the datagram
+ * @param length size of buffer
+ */
+int udp_socket_receive(co_obj_t *self, co_obj_t *fd, char *incoming, size_t length);
+
 
 #endif
@@ -576,15 +576,16 @@ co_tree_destroy(co_obj_t *root)
     }
 }
 
-static inline void
+static inline int
 _co_tree_raw_r(char **output, const size_t *olen, size_t *written, _treenode_t *current)
 {
-  if(current == NULL) return;
+  if(current == NULL) return 1;
   ssize_t klen = 0, vlen = 0; 
   char *kbuf = NULL, *vbuf = NULL;
   if(current->value != NULL)
   {
     CHECK((klen = co_obj_raw(&kbuf, current->key)) > 0, "Failed to read key.");
+    CHECK(klen < (*olen) - (*written), "Data too large for buffer.");
     memmove(*output, kbuf, klen);
     *output += klen;
     *written += klen;
@@ -601,19 +602,18 @@ _co_tree_raw_r(char **output, const size_t *olen, size_t *written, _treenode_t *
     else
     {
       CHECK((vlen = co_obj_raw(&vbuf, current->value)) > 0, "Failed to read value.");
-      CHECK((klen + vlen) < ((*olen) - (*written)), "Data too large for buffer.");
+      CHECK(vlen < ((*olen) - (*written)), "Data too large for buffer.");
       DEBUG("Dumping value %s of size %d with key %s of size %d.", vbuf, (int)vlen, kbuf, (int)klen);
       memmove(*output, vbuf, vlen);
     }
     *written += vlen;
     *output += vlen;
   }
-  _co_tree_raw_r(output, olen, written, current->low); 
-  _co_tree_raw_r(output, olen, written, current->equal); 
-  _co_tree_raw_r(output, olen, written, current->high); 
-  return; 
+  return _co_tree_raw_r(output, olen, written, current->low) &&
+    _co_tree_raw_r(output, olen, written, current->equal) &&
+    _co_tree_raw_r(output, olen, written, current->high);
 error:
-  return;
+  return 0;
 }
 
 ssize_t
@@ -621,6 +621,7 @@ co_tree_raw(char *output, const size_t olen, const co_obj_t *tree)
 {
   char *out = output;
   size_t written = 0;
+  CHECK(olen > sizeof(uint8_t) + sizeof(uint32_t), "Data too large for buffer.");
   switch(CO_TYPE(tree))
   {
     case _tree16:
@@ -644,7 +645,7 @@ co_tree_raw(char *output, const size_t olen, const co_obj_t *tree)
       break;
   }
   
-  _co_tree_raw_r(&out, &olen, &written, co_tree_root(tree));
+  CHECK(_co_tree_raw_r(&out, &olen, &written, co_tree_root(tree)), "Failed to dump tree.");
   DEBUG("Tree bytes written: %d", (int)written);
   return written;
 error:
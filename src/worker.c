@@ -0,0 +1,227 @@
+/* vim: set ts=2 expandtab: */
+/**
+ *       @file  worker.c
+ *      @brief  a bounded thread pool for running blocking jobs off the event loop
+ *
+ *     @author  Josh King (jheretic), jking@chambana.net
+ *
+ *   @internal
+ *     Created  10/19/2026
+ *    Revision  $Id: doxygen.commotion.templates,v 0.1 2013/01/01 09:00:00 jheretic Exp $
+ *    Compiler  gcc/g++
+ *     Company  The Open Technology Institute
+ *   Copyright  Copyright (c) 2013, Josh King
+ *
+ * This file is part of Commotion, Copyright (c) 2013, Josh King 
+ * 
+ * Commotion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * Commotion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Commotion.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =====================================================================================
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include "debug.h"
+#include "obj.h"
+#include "loop.h"
+#include "worker.h"
+
+typedef struct co_job_t co_job_t;
+
+struct co_job_t {
+  co_work_t work;
+  co_work_done_t done;
+  void *context;
+  int status;
+  co_job_t *next;
+};
+
+/* Jobs move pending -> (running) -> done. Everything below is guarded by
+ * _lock. */
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _ready = PTHREAD_COND_INITIALIZER;
+static pthread_t *_threads = NULL;
+static int _nthreads = 0;
+static int _queued = 0;
+static int _queue_max = 0;
+static bool _running = false;
+static co_job_t *_pending = NULL, *_pending_tail = NULL;
+static co_job_t *_done = NULL, *_done_tail = NULL;
+static int _efd = -1;
+
+//Private functions
+
+static void _co_job_push(co_job_t **head, co_job_t **tail, co_job_t *job) {
+  job->next = NULL;
+  if(*tail) (*tail)->next = job;
+  else *head = job;
+  *tail = job;
+}
+
+static co_job_t *_co_job_pop(co_job_t **head, co_job_t **tail) {
+  co_job_t *job = *head;
+  if(job) {
+    *head = job->next;
+    if(*head == NULL) *tail = NULL;
+  }
+  return job;
+}
+
+static void *_co_worker_run(void *arg) {
+  co_job_t *job = NULL;
+  uint64_t one = 1;
+
+  pthread_mutex_lock(&_lock);
+  while(true) {
+    while(_running && _pending == NULL)
+      pthread_cond_wait(&_ready, &_lock);
+    if(!_running) break;
+    job = _co_job_pop(&_pending, &_pending_tail);
+    pthread_mutex_unlock(&_lock);
+
+    job->status = job->work(job->context);
+
+    pthread_mutex_lock(&_lock);
+    _co_job_push(&_done, &_done_tail, job);
+    if(write(_efd, &one, sizeof(one)) != sizeof(one))
+      WARN("Failed to signal job completion.");
+  }
+  pthread_mutex_unlock(&_lock);
+  return NULL;
+}
+
+/* Runs on the loop thread: hand finished jobs back to their owners. */
+static void _co_workers_complete(void) {
+  co_job_t *jobs = NULL, *job = NULL;
+
+  pthread_mutex_lock(&_lock);
+  jobs = _done;
+  _done = _done_tail = NULL;
+  pthread_mutex_unlock(&_lock);
+
+  while((job = jobs)) {
+    jobs = job->next;
+    /* Counted out first, so the last callback sees the pool idle */
+    pthread_mutex_lock(&_lock);
+    _queued--;
+    pthread_mutex_unlock(&_lock);
+    job->done(job->context, job->status);
+    h_free(job);
+  }
+}
+
+static int _co_workers_poll_cb(int fd, uint32_t revents, void *context) {
+  uint64_t count = 0;
+  if(read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    WARN("Failed to read worker eventfd.");
+  _co_workers_complete();
+  return 1;
+}
+
+//Public functions
+
+int co_workers_init(const int threads, const int queue_max) {
+  CHECK(!_running, "Workers already initialized.");
+  CHECK(threads > 0 && queue_max > 0, "Invalid worker pool size.");
+  CHECK((_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) != -1, "Failed to create worker eventfd.");
+  CHECK(co_loop_watch_fd(_efd, EPOLLIN, _co_workers_poll_cb, NULL), "Failed to register worker eventfd.");
+
+  CHECK_MEM(_threads = h_calloc(threads, sizeof(pthread_t)));
+  _queue_max = queue_max;
+  _running = true;
+  for(_nthreads = 0; _nthreads < threads; _nthreads++)
+    CHECK(pthread_create(&_threads[_nthreads], NULL, _co_worker_run, NULL) == 0, "Failed to start worker thread.");
+  DEBUG("Started %d worker threads.", _nthreads);
+  return 1;
+
+error:
+  co_workers_shutdown();
+  return 0;
+}
+
+void co_workers_shutdown(void) {
+  co_job_t *job = NULL;
+
+  pthread_mutex_lock(&_lock);
+  _running = false;
+  pthread_cond_broadcast(&_ready);
+  pthread_mutex_unlock(&_lock);
+  for(int i = 0; i < _nthreads; i++)
+    pthread_join(_threads[i], NULL);
+  _nthreads = 0;
+  if(_threads) h_free(_threads);
+  _threads = NULL;
+
+  /* No threads left, so no locking needed past this point. */
+  _co_workers_complete();
+  while((job = _co_job_pop(&_pending, &_pending_tail))) {
+    job->done(job->context, -1);
+    h_free(job);
+  }
+  _queued = 0;
+
+  if(_efd != -1) {
+    co_loop_unwatch_fd(_efd);
+    close(_efd);
+  }
+  _efd = -1;
+  return;
+}
+
+int co_workers_busy(void) {
+  int queued = 0;
+  pthread_mutex_lock(&_lock);
+  queued = _queued;
+  pthread_mutex_unlock(&_lock);
+  return queued;
+}
+
+int co_worker_submit(co_work_t work, co_work_done_t done, void *context) {
+  co_job_t *job = NULL;
+  CHECK(work != NULL && done != NULL, "Invalid job.");
+
+  pthread_mutex_lock(&_lock);
+  if(!_running || _queued >= _queue_max) {
+    pthread_mutex_unlock(&_lock);
+    SENTINEL("Worker queue unavailable or full.");
+  }
+  _queued++;
+  pthread_mutex_unlock(&_lock);
+
+  job = h_calloc(1, sizeof(co_job_t));
+  if(job == NULL) {
+    pthread_mutex_lock(&_lock);
+    _queued--;
+    pthread_mutex_unlock(&_lock);
+    SENTINEL("Out of memory.");
+  }
+  job->work = work;
+  job->done = done;
+  job->context = context;
+
+  pthread_mutex_lock(&_lock);
+  _co_job_push(&_pending, &_pending_tail, job);
+  pthread_cond_signal(&_ready);
+  pthread_mutex_unlock(&_lock);
+  return 1;
+
+error:
+  return 0;
+}
@@ -0,0 +1,84 @@
+/* vim: set ts=2 expandtab: */
+/**
+ *       @file  worker.h
+ *      @brief  a bounded thread pool for running blocking jobs off the event loop
+ *
+ *     @author  Josh King (jheretic), jking@chambana.net
+ *
+ *   @internal
+ *     Created  10/19/2026
+ *    Revision  $Id: doxygen.commotion.templates,v 0.1 2013/01/01 09:00:00 jheretic Exp $
+ *    Compiler  gcc/g++
+ *     Company  The Open Technology Institute
+ *   Copyright  Copyright (c) 2013, Josh King
+ *
+ * This file is part of Commotion, Copyright (c) 2013, Josh King 
+ * 
+ * Commotion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * Commotion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Commotion.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =====================================================================================
+ */
+
+#ifndef _WORKER_H
+#define _WORKER_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WORKER_THREADS 4
+#define WORKER_QUEUE_MAX 64
+
+/**
+ * @brief a job run on a worker thread; its return value is passed to the
+ * completion callback as status
+ */
+typedef int (*co_work_t)(void *context);
+
+/**
+ * @brief completion callback, always run on the event loop thread. status is
+ * the job's return value, or -1 if the job was dropped at shutdown.
+ */
+typedef void (*co_work_done_t)(void *context, int status);
+
+/**
+ * @brief starts the worker threads and registers their completion eventfd
+ * with the event loop (which must already be initialized)
+ * @param threads number of worker threads
+ * @param queue_max maximum number of jobs queued or running at once
+ */
+int co_workers_init(const int threads, const int queue_max);
+
+/**
+ * @brief stops the worker threads, completing any jobs still queued with
+ * status -1
+ */
+void co_workers_shutdown(void);
+
+/**
+ * @brief returns the number of jobs queued, running, or waiting for their
+ * completion callback
+ */
+int co_workers_busy(void);
+
+/**
+ * @brief queues a job for a worker thread
+ * @param work function run on the worker thread
+ * @param done function run on the loop thread once work has returned
+ * @param context argument passed to both
+ * @return 0 if the pool isn't running or the queue is full
+ */
+int co_worker_submit(co_work_t work, co_work_done_t done, void *context);
+
+#endif
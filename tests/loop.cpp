@@ -7,6 +7,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 extern "C" {
   #include "config.h"
   #include "debug.h"
@@ -18,6 +22,7 @@ extern "C" {
   #include "msg.h"
   #include "iface.h"
   #include "id.h"
+  #include "tree.h"
 }
 #include "gtest/gtest.h"
 
@@ -26,11 +31,21 @@ extern co_socket_t unix_socket_proto;
 bool timer1_success = false;
 bool timer2_success = false;
 bool timer3_success = false;
+uint32_t watch_revents = 0;
+int swap_fds[3];
+int stale_runs = 0;
+int deferred_runs = 0;
+struct timeval slack_fired;
 
 int timer1_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params);
 int timer2_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params);
 int timer3_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params);
 int loop_stop_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params);
+int watch_cb(int fd, uint32_t revents, void *context);
+int swap_cb(int fd, uint32_t revents, void *context);
+int stale_cb(int fd, uint32_t revents, void *context);
+void defer_cb(void *context);
+int slack_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params);
 
 class LoopTest : public ::testing::Test
 {
@@ -52,6 +67,11 @@ class LoopTest : public ::testing::Test
     // tests
     void Timer();
     void Socket();
+    void Watch();
+    void WatchReuse();
+    void Defer();
+    void Refused();
+    void Slack();
     
     LoopTest()
     {
@@ -73,6 +93,7 @@ void LoopTest::Timer()
 {
   // intialize timer1
   co_obj_t *timer1 = co_timer_create(timeval1, timer1_cb, context1);
+  ASSERT_EQ(1, co_timer_set_name(timer1, "timer1"));
   ret = co_loop_set_timer(timer1, 1, context1);
   ASSERT_EQ(1, ret);
   
@@ -96,6 +117,21 @@ void LoopTest::Timer()
   EXPECT_TRUE(timer1_success);
   EXPECT_TRUE(timer2_success);
   EXPECT_TRUE(timer3_success);
+  
+  // all four timers were counted in the lateness histogram
+  co_obj_t *stats = co_loop_stats();
+  ASSERT_TRUE(stats != NULL);
+  co_obj_t *lateness = co_tree_find(stats, "timer_lateness", sizeof("timer_lateness"));
+  ASSERT_TRUE(lateness != NULL);
+  uint64_t *count = NULL;
+  ASSERT_EQ(sizeof(uint64_t), co_obj_data((char **)&count, co_tree_find(lateness, "count", sizeof("count"))));
+  EXPECT_LE(4, *count);
+  // listed by name, the unnamed ones together
+  co_obj_t *timers = co_tree_find(stats, "timers", sizeof("timers"));
+  ASSERT_TRUE(timers != NULL);
+  EXPECT_TRUE(co_tree_find(timers, "timer1", sizeof("timer1")) != NULL);
+  EXPECT_TRUE(co_tree_find(timers, "unnamed", sizeof("unnamed")) != NULL);
+  co_obj_free(stats);
 }
 
 void LoopTest::Socket()
@@ -116,6 +152,124 @@ void LoopTest::Socket()
   ASSERT_EQ(1, ret);
 }
 
+void LoopTest::Watch()
+{
+  int pipefd[2];
+  ASSERT_EQ(0, pipe(pipefd));
+  
+  ret = co_loop_watch_fd(pipefd[0], EPOLLIN, watch_cb, NULL);
+  ASSERT_EQ(1, ret);
+  ASSERT_EQ(1, write(pipefd[1], "x", 1));
+  
+  co_obj_t *loop_stop = co_timer_create(tv_stop, loop_stop_cb, stop);
+  ret = co_loop_set_timer(loop_stop, 20, stop);
+  ASSERT_EQ(1, ret);
+  co_loop_start();
+  EXPECT_TRUE(watch_revents & EPOLLIN);
+  
+  ret = co_loop_unwatch_fd(pipefd[0]);
+  ASSERT_EQ(1, ret);
+  ret = co_loop_unwatch_fd(pipefd[0]);
+  ASSERT_EQ(0, ret);
+  close(pipefd[0]);
+  close(pipefd[1]);
+}
+
+void LoopTest::WatchReuse()
+{
+  // two ready fds in one batch: whichever runs first unwatches the other and
+  // watches a third, which must not be handed the other's pending event
+  int a[2], b[2], c[2];
+  ASSERT_EQ(0, pipe(a));
+  ASSERT_EQ(0, pipe(b));
+  ASSERT_EQ(0, pipe(c));
+  swap_fds[0] = a[0];
+  swap_fds[1] = b[0];
+  swap_fds[2] = c[0];
+  ASSERT_EQ(1, co_loop_watch_fd(a[0], EPOLLIN, swap_cb, NULL));
+  ASSERT_EQ(1, co_loop_watch_fd(b[0], EPOLLIN, swap_cb, NULL));
+  ASSERT_EQ(1, write(a[1], "x", 1));
+  ASSERT_EQ(1, write(b[1], "x", 1));
+  co_obj_t *loop_stop = co_timer_create(tv_stop, loop_stop_cb, stop);
+  ret = co_loop_set_timer(loop_stop, 20, stop);
+  ASSERT_EQ(1, ret);
+  co_loop_start();
+  EXPECT_EQ(0, stale_runs);
+  
+  co_loop_unwatch_fd(a[0]);
+  co_loop_unwatch_fd(b[0]);
+  co_loop_unwatch_fd(c[0]);
+  close(a[0]); close(a[1]);
+  close(b[0]); close(b[1]);
+  close(c[0]); close(c[1]);
+}
+
+void LoopTest::Defer()
+{
+  ret = co_loop_defer(defer_cb, NULL);
+  ASSERT_EQ(1, ret);
+  ret = co_loop_defer(defer_cb, &ret);
+  ASSERT_EQ(1, ret);
+  
+  co_loop_start();
+  // the second callback stopped the loop after both ran in order
+  EXPECT_EQ(2, deferred_runs);
+}
+
+void LoopTest::Refused()
+{
+  char uri[32];
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  
+  // a port nothing listens on any more
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_LE(0, fd);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(0, bind(fd, (struct sockaddr*)&addr, sizeof(addr)));
+  ASSERT_EQ(0, getsockname(fd, (struct sockaddr*)&addr, &addrlen));
+  close(fd);
+  snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+  
+  co_socket_t *client = (co_socket_t*)co_socket_create_uri(uri);
+  ASSERT_TRUE(client);
+  client->register_cb = co_loop_add_socket;
+  if(!client->connect((co_obj_t*)client, uri)) {
+    // refused before the loop got to see it
+    co_socket_destroy((co_obj_t*)client);
+    return;
+  }
+  co_obj_t *loop_stop = co_timer_create(tv_stop, loop_stop_cb, stop);
+  ret = co_loop_set_timer(loop_stop, 20, stop);
+  ASSERT_EQ(1, ret);
+  co_loop_start();
+  
+  // hung up and out of the loop, so destroying it closes nothing twice
+  EXPECT_EQ(-1, client->fd->fd);
+  EXPECT_TRUE(co_loop_get_socket(uri, NULL) == NULL);
+  co_socket_destroy((co_obj_t*)client);
+}
+
+void LoopTest::Slack()
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  
+  // due first, but allowed to wait for the second
+  co_obj_t *timer1 = co_timer_create(timeval1, slack_cb, context1);
+  ret = co_loop_set_timer_slack(timer1, 5, 50, NULL);
+  ASSERT_EQ(1, ret);
+  co_obj_t *loop_stop = co_timer_create(tv_stop, loop_stop_cb, stop);
+  ret = co_loop_set_timer(loop_stop, 20, stop);
+  ASSERT_EQ(1, ret);
+  
+  co_loop_start();
+  long elapsed = (slack_fired.tv_sec - start.tv_sec) * 1000 + (slack_fired.tv_usec - start.tv_usec) / 1000;
+  EXPECT_LE(19, elapsed);
+}
+
 TEST_F(LoopTest, Timer)
 {
   Timer();
@@ -125,6 +279,31 @@ TEST_F(LoopTest, Socket)
 {
   Socket();
 }
+
+TEST_F(LoopTest, Watch)
+{
+  Watch();
+}
+
+TEST_F(LoopTest, WatchReuse)
+{
+  WatchReuse();
+}
+
+TEST_F(LoopTest, Defer)
+{
+  Defer();
+}
+
+TEST_F(LoopTest, Refused)
+{
+  Refused();
+}
+
+TEST_F(LoopTest, Slack)
+{
+  Slack();
+}
   
   
 // callback functions
@@ -146,6 +325,41 @@ int timer3_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params)
   return 1;
 }
 
+int watch_cb(int fd, uint32_t revents, void *context)
+{
+  char c;
+  if(read(fd, &c, 1) != 1) return 0;
+  watch_revents = revents;
+  return 1;
+}
+
+int swap_cb(int fd, uint32_t revents, void *context)
+{
+  char ch;
+  if(read(fd, &ch, 1) != 1) return 0;
+  co_loop_unwatch_fd(fd == swap_fds[0] ? swap_fds[1] : swap_fds[0]);
+  co_loop_watch_fd(swap_fds[2], EPOLLIN, stale_cb, NULL);
+  return 1;
+}
+
+int stale_cb(int fd, uint32_t revents, void *context)
+{
+  stale_runs++;
+  return 1;
+}
+
+void defer_cb(void *context)
+{
+  deferred_runs++;
+  if(context != NULL) co_loop_stop();
+}
+
+int slack_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params)
+{
+  gettimeofday(&slack_fired, NULL);
+  return 1;
+}
+
 // loop stop function (currently unused)
 int loop_stop_cb(co_obj_t *self, co_obj_t **output, co_obj_t *params)
 {
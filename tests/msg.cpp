@@ -48,6 +48,7 @@ protected:
   
   // functions
   void Request();
+  void Frames();
   
   MessageTest()
   {
@@ -79,7 +80,39 @@ void MessageTest::Request()
   ASSERT_EQ(sizeof(uint32_t), co_obj_data((char **)&id, co_list_element(request, 1)));
 }
 
+void MessageTest::Frames()
+{
+  // two requests back to back, as co_call_batch sends them
+  size_t first = co_request_alloc(req, REQUEST_MAX, m, param);
+  size_t second = co_request_alloc(req + first, REQUEST_MAX - first, m, param);
+  ASSERT_EQ(co_request_id(req) + 1, co_request_id(req + first));
+
+  ASSERT_EQ(first, co_message_length(req, first + second));
+  ASSERT_EQ(second, co_message_length(req + first, second));
+
+  // a request cut short needs more data
+  for (size_t i = 0; i < second; i++)
+    ASSERT_EQ(0, co_message_length(req + first, i));
+
+  // a response carrying a tree
+  co_obj_t *nil = co_nil_create(0), *result = co_tree16_create();
+  co_tree_insert(result, "key", sizeof("key"), co_str8_create("value", sizeof("value"), 0));
+  len = co_response_alloc(resp, RESPONSE_MAX, 7, nil, result);
+  ASSERT_EQ(len, co_message_length(resp, len));
+  ASSERT_EQ(0, co_message_length(resp, len - 1));
+
+  resp[0] = 0xc1; // never used
+  ASSERT_EQ(-1, co_message_length(resp, len));
+  co_obj_free(nil);
+  co_obj_free(result);
+}
+
 TEST_F (MessageTest, Request)
 {
   Request();
+}
+
+TEST_F (MessageTest, Frames)
+{
+  Frames();
 }
\ No newline at end of file
@@ -5,25 +5,32 @@ extern "C" {
 #include "../src/profile.h"
 }
 #include "gtest/gtest.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
 
 SCHEMA(default)
 {
   SCHEMA_ADD("ssid", "commotionwireless.net"); 
-  SCHEMA_ADD("bssid", "02:CA:FF:EE:BA:BE"); 
-  SCHEMA_ADD("bssidgen", "true"); 
-  SCHEMA_ADD("channel", "5"); 
-  SCHEMA_ADD("mode", "adhoc"); 
-  SCHEMA_ADD("type", "mesh"); 
+  SCHEMA_ADD_TYPED("bssid", "02:CA:FF:EE:BA:BE", PROFILE_MAC); 
+  SCHEMA_ADD_TYPED("bssidgen", "true", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("channel", "5", PROFILE_UINT); 
+  SCHEMA_ADD_ENUM("mode", "adhoc", "adhoc|ap|sta|mesh"); 
+  SCHEMA_ADD_ENUM("type", "mesh", "mesh|ap|plug|client"); 
   SCHEMA_ADD("dns", "208.67.222.222"); 
   SCHEMA_ADD("domain", "mesh.local"); 
-  SCHEMA_ADD("ipgen", "true"); 
-  SCHEMA_ADD("ip", "100.64.0.0"); 
-  SCHEMA_ADD("netmask", "255.192.0.0"); 
-  SCHEMA_ADD("ipgenmask", "255.192.0.0"); 
+  SCHEMA_ADD_TYPED("ipgen", "true", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("ip", "100.64.0.0", PROFILE_IPV4); 
+  SCHEMA_ADD_TYPED("netmask", "255.192.0.0", PROFILE_IPV4); 
+  SCHEMA_ADD_TYPED("ipgenmask", "255.192.0.0", PROFILE_IPV4); 
   SCHEMA_ADD("encryption", "psk2"); 
   SCHEMA_ADD("key", "c0MM0t10n!r0cks"); 
-  SCHEMA_ADD("serval", "false"); 
-  SCHEMA_ADD("announce", "true"); 
+  SCHEMA_ADD_TYPED("serval", "false", PROFILE_BOOL); 
+  SCHEMA_ADD_TYPED("announce", "true", PROFILE_BOOL); 
   return 1;
 }
 
@@ -36,6 +43,12 @@ protected:
   void Find();
   void Remove();
   void SetGet();
+  void ImportFiles();
+  void ImportBenchmark();
+  void Reload();
+  void Prefix();
+  void Export();
+  void Journal();
   
   // variables
   int ret = 0;
@@ -55,6 +68,7 @@ protected:
   
   ~ProfileTest()
   {
+    co_profiles_shutdown();
   }
 };
 
@@ -82,6 +96,14 @@ void ProfileTest::Find()
   
   found = co_profile_find(profile2);
   ASSERT_TRUE(NULL != found);
+
+  // lookup by raw name, with or without the terminating NUL
+  ASSERT_TRUE(found == co_profile_find_str("profile2", 8));
+  ASSERT_TRUE(found == co_profile_find_str("profile2", 9));
+
+  // duplicate names are refused
+  ret = co_profile_add("profile2", 9);
+  ASSERT_EQ(0, ret);
 }
 
 void ProfileTest::Remove()
@@ -120,10 +142,408 @@ void ProfileTest::SetGet()
   ret = co_profile_set_str((co_obj_t *)found, "ip", sizeof("ip"), "192.168.1.254", sizeof("192.168.1.254"));
   ASSERT_EQ(1, ret);
   
-  char *ip;
+  char ip[INET_ADDRSTRLEN];
+  struct in_addr addr;
   
-  ret = co_profile_get_str(found, &ip, "ip", sizeof("ip"));
+  ret = co_profile_get_text(found, "ip", sizeof("ip"), ip, sizeof(ip));
   ASSERT_STREQ("192.168.1.254", ip);
+  ASSERT_EQ(1, co_profile_get_ipv4(found, "ip", sizeof("ip"), &addr));
+  ASSERT_EQ(inet_addr("192.168.1.254"), addr.s_addr);
+
+  // defaults are shared; setting one on a profile leaves the others alone
+  ret = co_profile_add("profile2", 9);
+  ASSERT_EQ(1, ret);
+  ret = co_profile_get_text(co_profile_find(profile2), "ip", sizeof("ip"), ip, sizeof(ip));
+  ASSERT_STREQ("100.64.0.0", ip);
+
+  // typed values are parsed once when set, and refused if they don't parse
+  ASSERT_EQ(5, co_profile_get_uint(found, "channel", sizeof("channel")));
+  ASSERT_EQ(1, co_profile_set_str(found, "channel", sizeof("channel"), "11", sizeof("11")));
+  ASSERT_EQ(11, co_profile_get_uint(found, "channel", sizeof("channel")));
+  ASSERT_EQ(0, co_profile_set_str(found, "channel", sizeof("channel"), "eleven", sizeof("eleven")));
+  ASSERT_EQ(1, co_profile_get_bool(found, "ipgen", sizeof("ipgen")));
+  ASSERT_EQ(1, co_profile_set_str(found, "ipgen", sizeof("ipgen"), "false", sizeof("false")));
+  ASSERT_EQ(0, co_profile_get_bool(found, "ipgen", sizeof("ipgen")));
+  ASSERT_EQ(0, co_profile_set_str(found, "ip", sizeof("ip"), "10.0.0", sizeof("10.0.0")));
+  ASSERT_EQ(1, co_profile_set_str(found, "mode", sizeof("mode"), "ap", sizeof("ap")));
+  ASSERT_EQ(0, co_profile_set_str(found, "mode", sizeof("mode"), "bogus", sizeof("bogus")));
+  unsigned char mac[PROFILE_MAC_SIZE];
+  ASSERT_EQ(1, co_profile_get_mac(found, "bssid", sizeof("bssid"), mac));
+  ASSERT_EQ(0xBE, mac[5]);
+  ASSERT_EQ(1, co_profile_set_str(found, "bssid", sizeof("bssid"), "02:ca:ff:ee:ba:01", sizeof("02:ca:ff:ee:ba:01")));
+  char bssid[18];
+  co_profile_get_text(found, "bssid", sizeof("bssid"), bssid, sizeof(bssid));
+  ASSERT_STREQ("02:CA:FF:EE:BA:01", bssid);
+  ASSERT_EQ(1, co_profile_get_bool(co_profile_find(profile2), "ipgen", sizeof("ipgen")));
+
+  // "ip" is a prefix of "ipgen" and "ipgenmask", so its node outlives its value
+  co_obj_t *p2 = co_profile_find(profile2);
+  ASSERT_EQ(1, co_profile_set_str(p2, "ipgenmask", sizeof("ipgenmask"), "255.0.0.0", sizeof("255.0.0.0")));
+  ASSERT_EQ(1, co_profile_set_str(p2, "ip", sizeof("ip"), "10.0.0.1", sizeof("10.0.0.1")));
+  ASSERT_EQ(1, co_profile_set_str(p2, "ipgen", sizeof("ipgen"), "false", sizeof("false")));
+  ASSERT_EQ(1, co_profile_set_str(p2, "ip", sizeof("ip"), "10.0.0.2", sizeof("10.0.0.2")));
+  ASSERT_EQ(1, co_profile_set_str(p2, "ipgen", sizeof("ipgen"), "true", sizeof("true")));
+  co_profile_get_text(p2, "ip", sizeof("ip"), ip, sizeof(ip));
+  ASSERT_STREQ("10.0.0.2", ip);
+
+  // derived values last until the profile changes
+  ASSERT_EQ(1, co_profile_set_derived(p2, "ip", sizeof("ip"), co_str8_create("10.0.0.9", sizeof("10.0.0.9"), 0)));
+  ASSERT_TRUE(NULL != co_profile_get_derived(p2, "ip", sizeof("ip")));
+  ASSERT_TRUE(NULL == co_profile_get_derived(found, "ip", sizeof("ip")));
+  ASSERT_EQ(1, co_profile_set_str(p2, "ssid", sizeof("ssid"), "changed", sizeof("changed")));
+  ASSERT_TRUE(NULL == co_profile_get_derived(p2, "ip", sizeof("ip")));
+  ASSERT_EQ(1, co_profile_set_derived(p2, "ip", sizeof("ip"), co_str8_create("10.0.0.9", sizeof("10.0.0.9"), 0)));
+  co_profiles_clear_derived();
+  ASSERT_TRUE(NULL == co_profile_get_derived(p2, "ip", sizeof("ip")));
+
+  // keys outside the schema can't be set
+  ret = co_profile_set_str((co_obj_t *)found, "nokey", sizeof("nokey"), "x", sizeof("x"));
+  ASSERT_EQ(0, ret);
+}
+
+static void
+write_profile(const char *dir, const char *name, const char *contents)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  ASSERT_TRUE(NULL != f);
+  fputs(contents, f);
+  fclose(f);
+}
+
+static co_obj_t *
+collect_names_i(co_obj_t *data, co_obj_t *current, void *context)
+{
+  char *name = NULL;
+  co_obj_data(&name, ((co_profile_t *)current)->name);
+  strcat((char *)context, name);
+  strcat((char *)context, " ");
+  return NULL;
+}
+
+void ProfileTest::ImportFiles()
+{
+  const char *names[] = { "p3", "p1", "bad", "p2", "p0" };
+  char dir[] = "/tmp/co_profilesXXXXXX";
+  char cache[64];
+  char contents[128];
+  char order[64];
+  char *ssid;
+
+  ASSERT_TRUE(NULL != mkdtemp(dir));
+  snprintf(cache, sizeof(cache), "%s.cache", dir);
+  for (int i = 0; i < 5; i++)
+  {
+    if (!strcmp(names[i], "bad"))
+      snprintf(contents, sizeof(contents), "{ \"ssid\": ");
+    else
+      snprintf(contents, sizeof(contents), "{ \"ssid\": \"node-%s\", \"channel\": \"%d\" }\n", names[i], i + 1);
+    write_profile(dir, names[i], contents);
+  }
+
+  // uncached, then a cold and a warm load through the profile cache
+  for (int run = 0; run < 3; run++)
+  {
+    if (run > 0)
+    {
+      co_profiles_shutdown();
+      ASSERT_EQ(1, co_profiles_init(16));
+    }
+    SCHEMA_REGISTER(default);
+    // one changed file must be reparsed rather than taken from the cache
+    if (run == 2)
+      write_profile(dir, "p2", "{ \"ssid\": \"changed\" }\n");
+    ASSERT_EQ(1, run ? co_profile_import_files_cached(dir, cache) : co_profile_import_files(dir));
+
+    // registered in name order, whichever thread loaded each, without the bad file
+    order[0] = '\0';
+    co_profiles_process(collect_names_i, order);
+    ASSERT_STREQ("p0 p1 p2 p3 ", order);
+    co_profile_get_str(co_profile_find_str("p3", 3), &ssid, "ssid", sizeof("ssid"));
+    ASSERT_STREQ("node-p3", ssid);
+    ASSERT_EQ(1, co_profile_get_uint(co_profile_find_str("p3", 3), "channel", sizeof("channel")));
+  }
+  co_profile_get_str(co_profile_find_str("p2", 3), &ssid, "ssid", sizeof("ssid"));
+  ASSERT_STREQ("changed", ssid);
+  co_profile_get_str(co_profile_find_str("p2", 3), &ssid, "mode", sizeof("mode"));
+  ASSERT_STREQ("adhoc", ssid);
+
+  for (int i = 0; i < 5; i++)
+  {
+    snprintf(contents, sizeof(contents), "%s/%s", dir, names[i]);
+    unlink(contents);
+  }
+  rmdir(dir);
+  unlink(cache);
+}
+
+/* Startup benchmark, run only when COMMOTION_PROFILE_BENCH is set to the
+ * number of profiles to generate */
+void ProfileTest::ImportBenchmark()
+{
+  const char *bench = getenv("COMMOTION_PROFILE_BENCH");
+  if (bench == NULL)
+    return;
+  const int count = atoi(bench) > 0 ? atoi(bench) : 2000;
+  char dir[] = "/tmp/co_profilesXXXXXX";
+  char cache[64];
+  char name[16];
+  char contents[128];
+
+  ASSERT_TRUE(NULL != mkdtemp(dir));
+  snprintf(cache, sizeof(cache), "%s.cache", dir);
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(name, sizeof(name), "p%04d", i);
+    snprintf(contents, sizeof(contents), "{\n  \"ssid\": \"node%d\",\n  \"channel\": \"%d\",\n"
+             "  \"ip\": \"10.%d.%d.1\",\n  \"mode\": \"adhoc\"\n}\n",
+             i, i % 11 + 1, i / 256 % 256, i % 256);
+    write_profile(dir, name, contents);
+  }
+
+  const char *runs[] = { "uncached", "cold cache", "warm cache" };
+  for (int run = 0; run < 3; run++)
+  {
+    co_profiles_shutdown();
+    ASSERT_EQ(1, co_profiles_init(16));
+    SCHEMA_REGISTER(default);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(1, run ? co_profile_import_files_cached(dir, cache) : co_profile_import_files(dir));
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    printf("Imported %d profiles (%s) in %lld us\n", count, runs[run], (long long)elapsed.count());
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    snprintf(contents, sizeof(contents), "%s/p%04d", dir, i);
+    unlink(contents);
+  }
+  rmdir(dir);
+  unlink(cache);
+}
+
+static int reloads = 0;
+
+static void count_reloads(const char *name, co_obj_t *profile, void *context)
+{
+  reloads++;
+}
+
+void ProfileTest::Reload()
+{
+  char dir[] = "/tmp/co_reloadXXXXXX";
+  char path[64];
+  char *ssid;
+
+  SCHEMA_REGISTER(default);
+  co_profile_hook(count_reloads, NULL);
+  ASSERT_TRUE(NULL != mkdtemp(dir));
+  snprintf(path, sizeof(path), "%s/r", dir);
+  FILE *f = fopen(path, "w");
+  fprintf(f, "{ \"ssid\": \"before\" }\n");
+  fclose(f);
+  ASSERT_EQ(1, co_profile_import_files(dir));
+  co_obj_t *old = co_profile_find_str("r", 2);
+  ASSERT_TRUE(NULL != old);
+
+  // a file that fails to parse leaves the loaded profile in place
+  f = fopen(path, "w");
+  fprintf(f, "{ \"ssid\": ");
+  fclose(f);
+  ASSERT_EQ(0, co_profile_reload(dir, "r"));
+  ASSERT_TRUE(old == co_profile_find_str("r", 2));
+
+  f = fopen(path, "w");
+  fprintf(f, "{ \"ssid\": \"after\" }\n");
+  fclose(f);
+  ASSERT_EQ(1, co_profile_reload(dir, "r"));
+  found = co_profile_find_str("r", 2);
+  ASSERT_TRUE(NULL != found && old != found);
+  co_profile_get_str(found, &ssid, "ssid", sizeof("ssid"));
+  ASSERT_STREQ("after", ssid);
+  ASSERT_EQ(1, reloads);
+
+  // the replaced profile is freed once nothing can point into it
+  co_profiles_collect();
+  ASSERT_TRUE(found == co_profile_find_str("r", 2));
+  co_profile_get_str(found, &ssid, "ssid", sizeof("ssid"));
+  ASSERT_STREQ("after", ssid);
+
+  unlink(path);
+  rmdir(dir);
+  ASSERT_EQ(1, co_profile_reload(dir, "r"));
+  ASSERT_TRUE(NULL == co_profile_find_str("r", 2));
+  ASSERT_EQ(2, reloads);
+}
+
+void ProfileTest::Prefix()
+{
+  char dir[] = "/tmp/co_prefixXXXXXX";
+  char path[64];
+  const char *names[] = { "mesh", "mesh2" };
+
+  SCHEMA_REGISTER(default);
+  // added, removed and re-added in both orders
+  for(int i = 0; i < 2; i++)
+  {
+    const char *first = names[i], *second = names[1 - i];
+    ASSERT_EQ(1, co_profile_add(first, strlen(first) + 1));
+    ASSERT_EQ(1, co_profile_add(second, strlen(second) + 1));
+    ASSERT_EQ(0, co_profile_add(second, strlen(second) + 1));
+    co_obj_t *a = co_profile_find_str(first, strlen(first) + 1);
+    co_obj_t *b = co_profile_find_str(second, strlen(second) + 1);
+    ASSERT_TRUE(NULL != a && NULL != b && a != b);
+    ASSERT_EQ(1, co_profile_remove(first, strlen(first) + 1));
+    ASSERT_TRUE(NULL == co_profile_find_str(first, strlen(first) + 1));
+    ASSERT_TRUE(b == co_profile_find_str(second, strlen(second) + 1));
+    ASSERT_EQ(1, co_profile_add(first, strlen(first) + 1));
+    ASSERT_EQ(1, co_profile_remove(second, strlen(second) + 1));
+    ASSERT_EQ(1, co_profile_remove(first, strlen(first) + 1));
+  }
+
+  // each reloaded while the other is loaded
+  ASSERT_TRUE(NULL != mkdtemp(dir));
+  for(int i = 0; i < 2; i++)
+  {
+    snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+    FILE *f = fopen(path, "w");
+    fprintf(f, "{ \"ssid\": \"%s\" }\n", names[i]);
+    fclose(f);
+  }
+  ASSERT_EQ(1, co_profile_import_files(dir));
+  for(int i = 0; i < 2; i++)
+  {
+    char *ssid = NULL;
+    co_obj_t *old = co_profile_find_str(names[i], strlen(names[i]) + 1);
+    ASSERT_TRUE(NULL != old);
+    snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+    FILE *f = fopen(path, "w");
+    fprintf(f, "{ \"ssid\": \"%s-reloaded\" }\n", names[i]);
+    fclose(f);
+    ASSERT_EQ(1, co_profile_reload(dir, names[i]));
+    found = co_profile_find_str(names[i], strlen(names[i]) + 1);
+    ASSERT_TRUE(NULL != found && old != found);
+    co_profile_get_str(found, &ssid, "ssid", sizeof("ssid"));
+    ASSERT_EQ(0, strncmp(names[i], ssid, strlen(names[i])));
+    ASSERT_TRUE(NULL != strstr(ssid, "-reloaded"));
+    ASSERT_TRUE(NULL != co_profile_find_str(names[1 - i], strlen(names[1 - i]) + 1));
+  }
+  for(int i = 0; i < 2; i++)
+  {
+    snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+    unlink(path);
+    ASSERT_EQ(1, co_profile_reload(dir, names[i]));
+    ASSERT_TRUE(NULL == co_profile_find_str(names[i], strlen(names[i]) + 1));
+  }
+  rmdir(dir);
+}
+
+void ProfileTest::Export()
+{
+  char path[] = "/tmp/co_exportXXXXXX";
+  char buf[1024];
+  struct stat before, after;
+
+  SCHEMA_REGISTER(default);
+  ASSERT_EQ(1, co_profile_add("profile1", 9));
+  found = co_profile_find(profile1);
+  ASSERT_EQ(1, co_profile_set_str(found, "ssid", sizeof("ssid"), "exported", sizeof("exported")));
+  int fd = mkstemp(path);
+  ASSERT_LE(0, fd);
+  close(fd);
+
+  ASSERT_EQ(1, co_profile_export_file(found, path));
+  FILE *f = fopen(path, "r");
+  size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[len] = '\0';
+  ASSERT_EQ(0, strncmp("{\n  \"", buf, 5));
+  ASSERT_TRUE(NULL != strstr(buf, "  \"ssid\": \"exported\",\n"));
+  ASSERT_TRUE(NULL != strstr(buf, "  \"channel\": \"5\""));
+  ASSERT_EQ('}', buf[len - 1]);
+
+  // an unchanged profile isn't rewritten; a changed one replaces the file
+  stat(path, &before);
+  ASSERT_EQ(1, co_profile_export_file(found, path));
+  stat(path, &after);
+  ASSERT_EQ(before.st_ino, after.st_ino);
+  ASSERT_EQ(1, co_profile_set_str(found, "channel", sizeof("channel"), "6", sizeof("6")));
+  ASSERT_EQ(1, co_profile_export_file(found, path));
+  stat(path, &after);
+  ASSERT_NE(before.st_ino, after.st_ino);
+  // mkstemp made it 0600, which the replacement keeps
+  ASSERT_EQ(0600, after.st_mode & 0777);
+  unlink(path);
+}
+
+struct journal_t
+{
+  int n;
+  struct
+  {
+    uint64_t version;
+    int change;
+    char name[16];
+    char key[16];
+  } entries[4];
+};
+
+static void
+_journal_i(uint64_t version, int change, const char *name, const char *key, void *context)
+{
+  journal_t *j = (journal_t *)context;
+  if(j->n >= 4) return;
+  j->entries[j->n].version = version;
+  j->entries[j->n].change = change;
+  snprintf(j->entries[j->n].name, sizeof(j->entries[j->n].name), "%s", name ? name : "");
+  snprintf(j->entries[j->n].key, sizeof(j->entries[j->n].key), "%s", key ? key : "");
+  j->n++;
+}
+
+void ProfileTest::Journal()
+{
+  journal_t j = {};
+
+  SCHEMA_REGISTER(default);
+  uint64_t base = co_profiles_version();
+  ASSERT_EQ(1, co_profile_add("profile1", 9));
+  found = co_profile_find(profile1);
+  ASSERT_EQ(base + 1, co_profile_version(found));
+  ASSERT_EQ(1, co_profile_set_str(found, "ssid", sizeof("ssid"), "journal", sizeof("journal")));
+  // a rejected value changes nothing
+  ASSERT_EQ(0, co_profile_set_str(found, "channel", sizeof("channel"), "x", sizeof("x")));
+  ASSERT_EQ(base + 2, co_profile_version(found));
+  ASSERT_EQ(1, co_profile_remove("profile1", 9));
+  ASSERT_EQ(base + 3, co_profiles_version());
+
+  ASSERT_EQ(1, co_profiles_changes(base + 1, _journal_i, &j));
+  ASSERT_EQ(2, j.n);
+  ASSERT_EQ(base + 2, j.entries[0].version);
+  ASSERT_EQ(PROFILE_CHANGE_SET, j.entries[0].change);
+  ASSERT_STREQ("profile1", j.entries[0].name);
+  ASSERT_STREQ("ssid", j.entries[0].key);
+  ASSERT_EQ(base + 3, j.entries[1].version);
+  ASSERT_EQ(PROFILE_CHANGE_REMOVE, j.entries[1].change);
+  ASSERT_STREQ("", j.entries[1].key);
+
+  j.n = 0;
+  ASSERT_EQ(1, co_profiles_changes(co_profiles_version(), _journal_i, &j));
+  ASSERT_EQ(0, j.n);
+  // a version ahead of ours is from an earlier run
+  ASSERT_EQ(0, co_profiles_changes(co_profiles_version() + 1, _journal_i, &j));
+  ASSERT_EQ(0, j.n);
+
+  // once changes fall out of the journal, readers have to start over
+  ASSERT_EQ(1, co_profile_add("profile2", 9));
+  found = co_profile_find(profile2);
+  for(int i = 0; i < PROFILE_JOURNAL_MAX; i++)
+    ASSERT_EQ(1, co_profile_set_str(found, "ssid", sizeof("ssid"), "journal", sizeof("journal")));
+  ASSERT_EQ(0, co_profiles_changes(base, _journal_i, &j));
+  ASSERT_EQ(0, j.n);
+  ASSERT_EQ(1, co_profiles_changes(co_profiles_version() - 1, _journal_i, &j));
+  ASSERT_EQ(1, j.n);
+  ASSERT_STREQ("profile2", j.entries[0].name);
 }
 
 TEST_F(ProfileTest, Init)
@@ -149,4 +569,34 @@ TEST_F(ProfileTest, Remove)
 TEST_F(ProfileTest, SetGet)
 {
   SetGet();
-}
\ No newline at end of file
+}
+
+TEST_F(ProfileTest, ImportFiles)
+{
+  ImportFiles();
+}
+
+TEST_F(ProfileTest, ImportBenchmark)
+{
+  ImportBenchmark();
+}
+
+TEST_F(ProfileTest, Reload)
+{
+  Reload();
+}
+
+TEST_F(ProfileTest, Prefix)
+{
+  Prefix();
+}
+
+TEST_F(ProfileTest, Export)
+{
+  Export();
+}
+
+TEST_F(ProfileTest, Journal)
+{
+  Journal();
+}
@@ -7,6 +7,9 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 extern "C" {
   #include "config.h"
   #include "debug.h"
@@ -19,11 +22,20 @@ extern "C" {
   #include "iface.h"
   #include "id.h"
   #include "list.h"
+  #include "tree.h"
 }
 #include "gtest/gtest.h"
 
 extern co_socket_t unix_socket_proto;
 
+static bool update_called = false;
+
+static int update_stub(co_obj_t *self, co_obj_t *context)
+{
+  update_called = true;
+  return 1;
+}
+
 class SocketTest : public ::testing::Test
 {
 protected:
@@ -31,6 +43,11 @@ protected:
   
   void Create();
   void SendReceive();
+  void SendQueue();
+  void TcpSendReceive();
+  void SeqpacketQueue();
+  void Limits();
+  void Reset();
   
   co_socket_t *socket1;
   co_socket_t *socket2;
@@ -58,6 +75,15 @@ void SocketTest::Create()
 {
   ASSERT_TRUE(socket1);
   ASSERT_TRUE(socket2);
+
+  // a path longer than sun_path is refused rather than overflowing it
+  char path[256];
+  memset(path, 'x', sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+  co_socket_t *socket3 = (co_socket_t*)co_socket_create(sizeof(co_socket_t), unix_socket_proto);
+  ASSERT_EQ(0, socket3->bind((co_obj_t*)socket3, path));
+  ASSERT_EQ(-1, socket3->fd->fd);
+  co_socket_destroy((co_obj_t *)socket3);
 }
   
 void SocketTest::SendReceive()
@@ -73,12 +99,154 @@ void SocketTest::SendReceive()
 
   received = co_socket_receive((co_obj_t *)socket1, (co_obj_t *)socket1->fd, buffer, length);
   
-  received = co_socket_receive((co_obj_t *)socket1, (co_obj_t *)co_list_get_first(socket1->rfd_lst), buffer, length);
+  received = co_socket_receive((co_obj_t *)socket1, (co_obj_t *)socket1->rfds, buffer, length);
   
   DEBUG("\n\nSent %d bytes.\n", ret);
   DEBUG("\n\nReceived %d bytes.\n", received);
   
   ASSERT_STREQ(test_message, buffer);
+  ASSERT_EQ(sizeof(test_message), socket2->fd->bytes_out);
+  ASSERT_EQ(sizeof(test_message), socket1->rfds->bytes_in);
+
+  co_fd_account((co_obj_t *)socket1->rfds, 250);
+  co_obj_t *connections = co_socket_connections((co_obj_t *)socket1);
+  ASSERT_EQ(1, co_tree_length(connections));
+  char key[16];
+  snprintf(key, sizeof(key), "%d", socket1->rfds->fd);
+  co_obj_t *conn = co_tree_find(connections, key, strlen(key) + 1);
+  ASSERT_TRUE(conn);
+  ASSERT_EQ(1, ((co_uint32_t *)co_tree_find(conn, "requests", sizeof("requests")))->data);
+  ASSERT_EQ(250, ((co_uint64_t *)co_tree_find(conn, "max_latency", sizeof("max_latency")))->data);
+  co_obj_free(connections);
+}
+
+void SocketTest::SendQueue()
+{
+  // large enough to overrun the socket buffer of an unaccepted connection
+  size_t length = 4 * 1024 * 1024;
+  char *big_message = (char *)calloc(1, length);
+  
+  // pretend the event loop manages this socket so sends don't block
+  socket2->update_cb = update_stub;
+  
+  ret = co_socket_send((co_obj_t *)socket2->fd, big_message, length);
+  ASSERT_EQ(length, ret);
+  ASSERT_TRUE(update_called);
+  ASSERT_LT(0, socket2->fd->outlen);
+  
+  // nobody is reading, so the queue can't drain
+  ret = co_socket_flush((co_obj_t *)socket2->fd);
+  ASSERT_EQ(socket2->fd->outlen, ret);
+  
+  free(big_message);
+}
+
+void SocketTest::TcpSendReceive()
+{
+  char buffer[13];
+  char test_message[13] = "test message";
+  char uri[32];
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  
+  co_socket_t *server = (co_socket_t*)co_socket_create_uri("tcp://127.0.0.1:0");
+  ASSERT_TRUE(server);
+  ASSERT_EQ(1, server->bind((co_obj_t*)server, "tcp://127.0.0.1:0"));
+  ASSERT_EQ(0, getsockname(server->fd->fd, (struct sockaddr*)&addr, &addrlen));
+  snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+  
+  co_socket_t *client = (co_socket_t*)co_socket_create_uri(uri);
+  ASSERT_TRUE(client);
+  ASSERT_EQ(1, client->connect((co_obj_t*)client, uri));
+  ASSERT_STREQ(uri, client->uri);
+  
+  int nodelay = 0;
+  ASSERT_EQ(1, client->getopt((co_obj_t*)client, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)));
+  ASSERT_TRUE(nodelay);
+  
+  ret = client->send((co_obj_t *)client->fd, test_message, sizeof(test_message));
+  ASSERT_EQ(sizeof(test_message), ret);
+  
+  // accept, then read from the accepted connection
+  server->receive((co_obj_t *)server, (co_obj_t *)server->fd, buffer, sizeof(buffer));
+  ret = server->receive((co_obj_t *)server, (co_obj_t *)server->rfds, buffer, sizeof(buffer));
+  ASSERT_EQ(sizeof(test_message), ret);
+  ASSERT_STREQ(test_message, buffer);
+  
+  co_socket_destroy((co_obj_t *)client);
+  co_socket_destroy((co_obj_t *)server);
+}
+
+void SocketTest::SeqpacketQueue()
+{
+  char message[1000], buffer[2000];
+  int sent = 0, received = 0;
+  memset(message, 'x', sizeof(message));
+  
+  co_socket_t *server = (co_socket_t*)co_socket_create_uri("unix+seqpacket://commotiontest-sp.sock");
+  ASSERT_EQ(1, server->bind((co_obj_t*)server, "unix+seqpacket://commotiontest-sp.sock"));
+  co_socket_t *client = (co_socket_t*)co_socket_create_uri("unix+seqpacket://commotiontest-sp.sock");
+  ASSERT_EQ(1, client->connect((co_obj_t*)client, "unix+seqpacket://commotiontest-sp.sock"));
+  
+  // send until messages start queueing behind the unaccepted connection
+  client->update_cb = update_stub;
+  while(client->fd->outlen == 0 && sent < 100000) {
+    ASSERT_EQ(sizeof(message), client->send((co_obj_t *)client->fd, message, sizeof(message)));
+    sent++;
+  }
+  ASSERT_LT(0, client->fd->outlen);
+  ASSERT_EQ(sizeof(message), client->send((co_obj_t *)client->fd, message, sizeof(message)));
+  sent++;
+  
+  // every queued message arrives whole
+  server->receive((co_obj_t *)server, (co_obj_t *)server->fd, buffer, sizeof(buffer));
+  co_fd_t *rfd = server->rfds;
+  ASSERT_TRUE(rfd->message);
+  while(received < sent) {
+    co_socket_flush((co_obj_t *)client->fd);
+    ASSERT_EQ(sizeof(message), server->receive((co_obj_t *)server, (co_obj_t *)rfd, buffer, sizeof(buffer)));
+    received++;
+  }
+  ASSERT_EQ(0, client->fd->outlen);
+  
+  co_socket_destroy((co_obj_t *)client);
+  co_socket_destroy((co_obj_t *)server);
+}
+
+void SocketTest::Limits()
+{
+  char buffer[16];
+  socket1->max_connections = 1;
+  
+  // socket2 is accepted, the extra connection is refused
+  co_socket_t *socket3 = (co_socket_t*)co_socket_create(sizeof(co_socket_t), unix_socket_proto);
+  ASSERT_EQ(1, socket3->connect((co_obj_t*)socket3, "commotiontest.sock"));
+  ret = co_socket_receive((co_obj_t *)socket1, (co_obj_t *)socket1->fd, buffer, sizeof(buffer));
+  ASSERT_EQ(0, ret);
+  ASSERT_EQ(1, socket1->rfd_count);
+  
+  // nothing has been idle for a minute, but everything for less than no time
+  ASSERT_EQ(0, co_socket_evict_idle((co_obj_t *)socket1, 60));
+  ASSERT_EQ(1, co_socket_evict_idle((co_obj_t *)socket1, -1));
+  ASSERT_EQ(0, socket1->rfd_count);
+  
+  co_socket_destroy((co_obj_t *)socket3);
+}
+
+void SocketTest::Reset()
+{
+  char buffer[16];
+  char message[] = "unread";
+
+  ASSERT_EQ(sizeof(message), co_socket_send((co_obj_t *)socket2->fd, message, sizeof(message)));
+  co_socket_receive((co_obj_t *)socket1, (co_obj_t *)socket1->fd, buffer, sizeof(buffer));
+  ASSERT_TRUE(NULL != socket1->rfds);
+
+  // closing with the message unread resets the connection, which the
+  // client reads as end-of-file
+  close(socket1->rfds->fd);
+  ASSERT_EQ(0, co_socket_receive((co_obj_t *)socket2, (co_obj_t *)socket2->fd, buffer, sizeof(buffer)));
+  socket1->rfds->fd = -1;
 }
 
 TEST_F(SocketTest, Create)
@@ -90,3 +258,28 @@ TEST_F(SocketTest, SendReceive)
 {
   SendReceive();
 }
+
+TEST_F(SocketTest, SendQueue)
+{
+  SendQueue();
+}
+
+TEST_F(SocketTest, TcpSendReceive)
+{
+  TcpSendReceive();
+}
+
+TEST_F(SocketTest, SeqpacketQueue)
+{
+  SeqpacketQueue();
+}
+
+TEST_F(SocketTest, Limits)
+{
+  Limits();
+}
+
+TEST_F(SocketTest, Reset)
+{
+  Reset();
+}